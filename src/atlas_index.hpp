@@ -0,0 +1,374 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+
+Binary atlas index (.tpi) - written by texpack with --index=bin
+
+This header has no dependencies on the rest of texpack and can be dropped into a game.
+All values are little endian, all sections are 4 byte aligned:
+
+	header
+	frame[frame_count]   - sorted by name hash
+	page[page_count]
+	slice[frame_count]   - only with the has_slices header flag, in frame table order
+	string pool          - zero terminated names
+
+The reader maps the file and looks frames up in place, without parsing or allocating:
+
+	atlas_index::reader index;
+	if (index.open("terrain.tpi"))
+	{
+		auto frame = index.find("grass.png");
+		auto page = index.page(frame->page);
+	}
+
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace atlas_index
+{
+	//File signature
+	static const char magic[4] = { 'T', 'P', 'I', 'X' };
+	//Format version
+	static const uint16_t version = 1;
+
+	//Header flags
+	enum header_flags : uint16_t
+	{
+		//A slice table follows the page table (see reader::slice())
+		has_slices = 1 << 0,
+	};
+
+	//Frame flags
+	enum frame_flags : uint8_t
+	{
+		//Stored rotated by 90 degrees clockwise in the page
+		rotated = 1 << 0,
+		//Stretched as a nine-slice, its borders are in the slice table
+		nine_slice = 1 << 1,
+	};
+
+	//Page flags
+	enum page_flags : uint32_t
+	{
+		//Alpha is in a second texture, "<name>@alpha", as gray
+		alpha_separate = 1 << 0,
+		//Alpha is in the bottom half of the texture, as gray
+		alpha_bottom = 1 << 1,
+		//Colors are premultiplied by alpha
+		premultiplied = 1 << 2,
+		//Frames are masks in one channel each (see frame::channel)
+		channel_packed = 1 << 3,
+		//Alpha is in a mask file, its name follows the texture's in the string pool (see reader::alpha_name())
+		alpha_mask = 1 << 4,
+	};
+
+#pragma pack(push, 1)
+	struct header
+	{
+		//Signature ("TPIX")
+		char magic[4];
+		//Format version
+		uint16_t version;
+		//header_flags
+		uint16_t flags;
+		//Number of frames
+		uint32_t frame_count;
+		//Number of pages (textures)
+		uint32_t page_count;
+		//Offset of the frame table
+		uint32_t frames_offset;
+		//Offset of the page table
+		uint32_t pages_offset;
+		//Offset of the string pool
+		uint32_t strings_offset;
+		//Size of the string pool
+		uint32_t strings_size;
+	};
+
+	struct frame
+	{
+		//Name (string pool offset)
+		uint32_t name;
+		//Name hash (see hash())
+		uint32_t hash;
+		//Rectangle in the page
+		uint16_t x, y, w, h;
+		//Sprite offset
+		int16_t offset_x, offset_y;
+		//Source sprite size
+		uint16_t source_w, source_h;
+		//Page the frame is on
+		uint16_t page;
+		//frame_flags
+		uint8_t flags;
+		//Channel of the frame in a channel_packed page (0-3 = R, G, B, A), 0 otherwise
+		uint8_t channel;
+	};
+
+	struct page
+	{
+		//Texture file name (string pool offset)
+		uint32_t name;
+		//Texture size
+		uint16_t width, height;
+		//Pixel format name, eg. "RGBA8888" (string pool offset)
+		uint32_t pixel_format;
+		//page_flags
+		uint32_t flags;
+	};
+
+	struct slice
+	{
+		//Border widths, the part of the frame between them is stretched
+		uint16_t left, top, right, bottom;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(header) == 32, "atlas_index::header must be 32 bytes");
+	static_assert(sizeof(frame) == 28, "atlas_index::frame must be 28 bytes");
+	static_assert(sizeof(page) == 16, "atlas_index::page must be 16 bytes");
+	static_assert(sizeof(slice) == 8, "atlas_index::slice must be 8 bytes");
+
+	//32-bit FNV-1a of a frame name
+	inline uint32_t hash(const char * name)
+	{
+		uint32_t result = 2166136261u;
+		while (*name)
+		{
+			result ^= (unsigned char)*name++;
+			result *= 16777619u;
+		}
+
+		return result;
+	}
+
+	//Reads a binary index in place (mapped file or memory owned by the caller)
+	class reader
+	{
+		const unsigned char * _data;
+		size_t _size;
+		bool _mapped;
+#ifdef _WIN32
+		HANDLE _file;
+		HANDLE _mapping;
+#endif
+
+	public:
+		reader() : _data(nullptr), _size(0), _mapped(false) { }
+		~reader() { close(); }
+		reader(const reader &) = delete;
+		reader & operator = (const reader &) = delete;
+
+		//Map an index file
+		bool open(const char * fname)
+		{
+			close();
+#ifdef _WIN32
+			_file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER size;
+			GetFileSizeEx(_file, &size);
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (_mapping == nullptr)
+			{
+				CloseHandle(_file);
+				return false;
+			}
+
+			_data = (const unsigned char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+			_size = (size_t)size.QuadPart;
+			_mapped = true;
+			if (_data == nullptr)
+			{
+				close();
+				return false;
+			}
+#else
+			int fd = ::open(fname, O_RDONLY);
+			if (fd < 0) return false;
+
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size <= 0)
+			{
+				::close(fd);
+				return false;
+			}
+
+			void * ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (ptr == MAP_FAILED) return false;
+
+			_data = (const unsigned char *)ptr;
+			_size = (size_t)st.st_size;
+			_mapped = true;
+#endif
+			if (!valid())
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		//Use an index already in memory (not copied, must outlive the reader)
+		bool open(const void * data, size_t size)
+		{
+			close();
+			_data = (const unsigned char *)data;
+			_size = size;
+			if (!valid())
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		//Release the index
+		void close()
+		{
+			if (_mapped && _data != nullptr)
+			{
+#ifdef _WIN32
+				UnmapViewOfFile(_data);
+#else
+				munmap((void *)_data, _size);
+#endif
+			}
+#ifdef _WIN32
+			if (_mapped)
+			{
+				CloseHandle(_mapping);
+				CloseHandle(_file);
+			}
+#endif
+			_data = nullptr;
+			_size = 0;
+			_mapped = false;
+		}
+
+		//Is an index opened
+		bool opened() const { return _data != nullptr; }
+
+		//Index header
+		const header & head() const { return *(const header *)_data; }
+		//Number of frames
+		uint32_t frame_count() const { return head().frame_count; }
+		//Number of pages
+		uint32_t page_count() const { return head().page_count; }
+		//Frame table (sorted by hash)
+		const frame * frames() const { return (const frame *)(_data + head().frames_offset); }
+		//Page table
+		const atlas_index::page * pages() const { return (const atlas_index::page *)(_data + head().pages_offset); }
+		//A page by index
+		const atlas_index::page * page(uint32_t index) const { return index < page_count() ? pages() + index : nullptr; }
+		//Nine-slice borders of a frame (nullptr if it isn't one)
+		const atlas_index::slice * slice(const frame & frm) const
+		{
+			if (!(frm.flags & nine_slice) || !(head().flags & has_slices)) return nullptr;
+			const atlas_index::slice * table = (const atlas_index::slice *)(_data + head().pages_offset + head().page_count * sizeof(atlas_index::page));
+			return table + (&frm - frames());
+		}
+		//A string from the pool ("" if the offset is past it)
+		const char * string(uint32_t offset) const
+		{
+			if (offset >= head().strings_size) return "";
+			return (const char *)(_data + head().strings_offset + offset);
+		}
+		//Frame name
+		const char * name(const frame & frm) const { return string(frm.name); }
+		//Alpha mask file of a page, "<name>@alpha.png" or zlib compressed "<name>@alpha.raw.z" (nullptr if none)
+		const char * alpha_name(const atlas_index::page & pg) const
+		{
+			if (!(pg.flags & alpha_mask)) return nullptr;
+			uint32_t offset = pg.name + (uint32_t)strlen(string(pg.name)) + 1;
+			return offset < head().strings_size ? string(offset) : nullptr;
+		}
+
+		//Find a frame by name (nullptr if missing)
+		const frame * find(const char * name) const
+		{
+			if (!opened()) return nullptr;
+
+			uint32_t key = hash(name);
+			const frame * table = frames();
+			uint32_t lo = 0, hi = frame_count();
+			while (lo < hi)
+			{
+				uint32_t mid = lo + (hi - lo) / 2;
+				if (table[mid].hash < key) lo = mid + 1;
+				else hi = mid;
+			}
+
+			//Several names may share a hash
+			for (; lo < frame_count() && table[lo].hash == key; ++lo)
+				if (strcmp(string(table[lo].name), name) == 0)
+					return &table[lo];
+
+			return nullptr;
+		}
+
+	private:
+		//Check that all sections lie inside the data
+		bool valid() const
+		{
+			if (_data == nullptr || _size < sizeof(header)) return false;
+
+			const header & hdr = head();
+			if (memcmp(hdr.magic, magic, sizeof(magic)) != 0) return false;
+			if (hdr.version != version) return false;
+
+			uint64_t frames_end = (uint64_t)hdr.frames_offset + (uint64_t)hdr.frame_count * sizeof(frame);
+			uint64_t pages_end = (uint64_t)hdr.pages_offset + (uint64_t)hdr.page_count * sizeof(atlas_index::page);
+			uint64_t strings_end = (uint64_t)hdr.strings_offset + hdr.strings_size;
+			if (frames_end > _size || pages_end > _size || strings_end > _size) return false;
+			if ((hdr.flags & has_slices) && pages_end + (uint64_t)hdr.frame_count * sizeof(atlas_index::slice) > _size) return false;
+
+			//The pool must end with a terminator, so string() never runs past it
+			if (hdr.strings_size > 0 && _data[strings_end - 1] != 0) return false;
+			return true;
+		}
+	};
+}
@@ -0,0 +1,205 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "emitter.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+namespace
+{
+	//"00".."99" - two digits per lookup
+	const char digit_pairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+}
+
+////////////////////////////////////////////////////////////////////
+
+emitter::format::format(const char * text)
+	: _text(text)
+{
+	segment seg = { 0, 0, 0 };
+	for (size_t i = 0; i < _text.size(); ++i)
+	{
+		if (_text[i] != '%' || i + 1 >= _text.size())
+			continue;
+
+		char type = _text[i + 1];
+		if (type == '%')
+		{
+			//Literal percent - end the literal after the first one
+			seg.length = i + 1 - seg.offset;
+			_segments.push_back(seg);
+			seg.offset = i + 2;
+			++i;
+			continue;
+		}
+
+		assert(type == 'd' || type == 's' || type == 'r');
+		seg.length = i - seg.offset;
+		seg.slot = type;
+		_segments.push_back(seg);
+
+		seg.offset = i + 2;
+		seg.slot = 0;
+		++i;
+	}
+
+	seg.length = _text.size() - seg.offset;
+	_segments.push_back(seg);
+}
+
+size_t emitter::format::slots() const
+{
+	size_t count = 0;
+	for (auto & seg : _segments)
+		if (seg.slot != 0) ++count;
+	return (count);
+}
+
+////////////////////////////////////////////////////////////////////
+
+emitter::value::value(int integer)
+	: integer(integer), string(nullptr), length(0) { }
+
+emitter::value::value(unsigned integer)
+	: integer((int)integer), string(nullptr), length(0) { }
+
+emitter::value::value(const char * string)
+	: integer(0), string(string), length(strlen(string)) { }
+
+emitter::value::value(const std::string & string)
+	: integer(0), string(string.c_str()), length(string.size()) { }
+
+////////////////////////////////////////////////////////////////////
+
+emitter::emitter()
+{
+	_buffer.reserve(64 * 1024);
+}
+
+void emitter::write(const char * text)
+{
+	_buffer.append(text);
+}
+
+void emitter::write(const char * text, size_t length)
+{
+	_buffer.append(text, length);
+}
+
+void emitter::write_int(int value)
+{
+	char digits[16];
+	char * end = digits + sizeof(digits);
+	char * ptr = end;
+
+	unsigned magnitude = (value < 0) ? (0u - (unsigned)value) : (unsigned)value;
+	while (magnitude >= 100)
+	{
+		unsigned pair = (magnitude % 100) * 2;
+		magnitude /= 100;
+		*--ptr = digit_pairs[pair + 1];
+		*--ptr = digit_pairs[pair];
+	}
+
+	if (magnitude >= 10)
+	{
+		*--ptr = digit_pairs[magnitude * 2 + 1];
+		*--ptr = digit_pairs[magnitude * 2];
+	}
+	else
+	{
+		*--ptr = (char)('0' + magnitude);
+	}
+
+	if (value < 0) *--ptr = '-';
+	_buffer.append(ptr, end - ptr);
+}
+
+void emitter::write_escaped(const char * text, size_t length)
+{
+	size_t run = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		const char * entity = nullptr;
+		switch (text[i])
+		{
+		case '&': entity = "&amp;"; break;
+		case '<': entity = "&lt;"; break;
+		case '>': entity = "&gt;"; break;
+		case '"': entity = "&quot;"; break;
+		case '\'': entity = "&apos;"; break;
+		default: continue;
+		}
+
+		//Copy the plain run before the entity at once
+		_buffer.append(text + run, i - run);
+		_buffer.append(entity);
+		run = i + 1;
+	}
+
+	_buffer.append(text + run, length - run);
+}
+
+void emitter::emit(const format & fmt, std::initializer_list<value> values)
+{
+	assert(values.size() == fmt.slots());
+
+	const char * text = fmt.text().data();
+	auto val = values.begin();
+	for (auto & seg : fmt.segments())
+	{
+		_buffer.append(text + seg.offset, seg.length);
+
+		if (seg.slot == 'd')
+			write_int((val++)->integer);
+		else if (seg.slot == 's')
+		{
+			write_escaped(val->string, val->length);
+			++val;
+		}
+		else if (seg.slot == 'r')
+		{
+			_buffer.append(val->string, val->length);
+			++val;
+		}
+	}
+}
+
+bool emitter::flush(core::fwriter & writer)
+{
+	if (_buffer.empty()) return true;
+
+	size_t written = writer.write((void*)_buffer.data(), 1, _buffer.size());
+	bool success = (written == _buffer.size());
+	_buffer.clear();
+	return success;
+}
@@ -0,0 +1,108 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "io/fwriter.hpp"
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+//Formats index files into a memory buffer, which is written out at once
+class emitter
+{
+public:
+	//A printf-like template, split once into literal segments and value slots
+	//Supported slots are %d (integer), %s (string, XML-escaped) and %r (string, as is)
+	class format
+	{
+	public:
+		//A literal followed by a slot
+		struct segment
+		{
+			//Literal start in the template
+			size_t offset;
+			//Literal length
+			size_t length;
+			//Slot type ('d', 's', 'r' or 0 for none)
+			char slot;
+		};
+
+	private:
+		std::string _text;
+		std::vector<segment> _segments;
+
+	public:
+		//Compile a template
+		format(const char * text);
+
+		//Template text
+		inline const std::string & text() const { return _text; }
+		//Template segments
+		inline const std::vector<segment> & segments() const { return _segments; }
+		//Number of value slots
+		size_t slots() const;
+	};
+
+	//A value for a template slot
+	struct value
+	{
+		//Integer value (for %d)
+		int integer;
+		//String value (for %s and %r)
+		const char * string;
+		//String length
+		size_t length;
+
+		value(int integer);
+		value(unsigned integer);
+		value(const char * string);
+		value(const std::string & string);
+	};
+
+private:
+	std::string _buffer;
+
+public:
+	//Construct an empty emitter
+	emitter();
+
+	//Emitted data
+	inline const char * data() const { return _buffer.data(); }
+	//Emitted data size
+	inline size_t size() const { return _buffer.size(); }
+	//Drop the emitted data
+	inline void clear() { _buffer.clear(); }
+
+	//Append raw text
+	void write(const char * text);
+	//Append raw text
+	void write(const char * text, size_t length);
+	//Append an integer as text
+	void write_int(int value);
+	//Append XML-escaped text
+	void write_escaped(const char * text, size_t length);
+	//Fill a template's slots in order
+	void emit(const format & fmt, std::initializer_list<value> values);
+
+	//Write everything emitted so far to a file
+	bool flush(core::fwriter & writer);
+};
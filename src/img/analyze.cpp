@@ -0,0 +1,74 @@
+#include "analyze.hpp"
+#include "palette.hpp"
+
+namespace img
+{
+	content analyze(const std::vector<const img *> & images)
+	{
+		content result;
+		result.opaque = true;
+		result.binary_alpha = true;
+		result.gray = true;
+		result.mask = true;
+
+		color_histogram colors(max_palette);
+		bool first_visible = true;
+		color visible;
+
+		for (auto image : images)
+		{
+			const color * pixels = (const color *)image->data();
+			size_t count = (size_t)image->w() * image->h();
+			if (colors.size() <= max_palette)
+				colors.add(pixels, count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const color & c = pixels[i];
+				if (c.a != 255) result.opaque = false;
+				if (c.a != 0 && c.a != 255) result.binary_alpha = false;
+
+				//Invisible pixels can be anything
+				if (c.a == 0) continue;
+				if (c.r != c.g || c.g != c.b) result.gray = false;
+
+				if (first_visible)
+				{
+					visible = c;
+					first_visible = false;
+				}
+				else if (c.r != visible.r || c.g != visible.g || c.b != visible.b)
+				{
+					result.mask = false;
+				}
+			}
+		}
+
+		//An opaque single color is no mask
+		if (result.opaque) result.mask = false;
+		result.mask_color = visible;
+		result.colors = (unsigned)colors.size();
+		return result;
+	}
+
+	void to_coverage(img & image)
+	{
+		bool mask = analyze({ &image }).mask;
+
+		color * pixels = (color *)image.data();
+		size_t count = (size_t)image.w() * image.h();
+		for (size_t i = 0; i < count; ++i)
+		{
+			color & c = pixels[i];
+			unsigned value = c.a;
+			if (!mask)
+			{
+				//Rec. 601 luma
+				unsigned luma = (c.r * 77 + c.g * 150 + c.b * 29 + 128) >> 8;
+				value = (luma * c.a + 127) / 255;
+			}
+
+			c.set((color::byte)value, (color::byte)value, (color::byte)value, (color::byte)value);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "img.hpp"
+
+#include <vector>
+
+namespace img
+{
+	//Most colors a palette can hold
+	const unsigned max_palette = 256;
+
+	//What the pixels of a set of images need
+	struct content
+	{
+		//Every pixel is opaque
+		bool opaque;
+		//Alpha is only ever 0 or 255
+		bool binary_alpha;
+		//Every visible pixel is gray (r = g = b)
+		bool gray;
+		//Every visible pixel has the same color, only alpha varies
+		bool mask;
+		//The color of a mask's visible pixels
+		color mask_color;
+		//Distinct colors, counted up to max_palette + 1
+		unsigned colors;
+	};
+
+	//Analyze the pixels of images, as if they were all in one texture
+	content analyze(const std::vector<const img *> & images);
+
+	//Replace every pixel by the image's coverage in all four channels, for packing it into one
+	//Single colored masks keep their alpha, anything else becomes luma times alpha
+	void to_coverage(img & image);
+}
@@ -0,0 +1,83 @@
+#include "astc.hpp"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	//.astc header (sizes are 24-bit little endian)
+	struct astc_header
+	{
+		uint8_t magic[4];
+		uint8_t block_x;
+		uint8_t block_y;
+		uint8_t block_z;
+		uint8_t width[3];
+		uint8_t height[3];
+		uint8_t depth[3];
+	};
+
+	static_assert(sizeof(astc_header) == 16, "ASTC header must be 16 bytes");
+
+	//0x5CA1AB13
+	const uint8_t astc_magic[4] = { 0x13, 0xAB, 0xA1, 0x5C };
+
+	inline void put_le24(uint8_t * dst, unsigned value)
+	{
+		dst[0] = (uint8_t)value;
+		dst[1] = (uint8_t)(value >> 8);
+		dst[2] = (uint8_t)(value >> 16);
+	}
+}
+
+namespace img
+{
+	astc::astc(unsigned w, unsigned h, pixel_format format, encode_quality quality)
+		: img(w, h)
+		, _format(format)
+		, _quality(quality)
+	{ }
+
+	astc::astc() : img(), _format(astc_4x4), _quality(quality_normal) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void astc::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+		if (!is_astc(_format))
+			throw std::exception("astc files support ASTC formats only");
+
+		unsigned block_w, block_h, block_bytes;
+		format_block(_format, block_w, block_h, block_bytes);
+
+		astc_header header;
+		memcpy(header.magic, astc_magic, sizeof(astc_magic));
+		header.block_x = (uint8_t)block_w;
+		header.block_y = (uint8_t)block_h;
+		header.block_z = 1;
+		put_le24(header.width, _w);
+		put_le24(header.height, _h);
+		put_le24(header.depth, 1);
+
+		auto blocks = encode_blocks(*this, _format, _quality);
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		fp.write(header);
+		fp.write(blocks.data(), 1, blocks.size());
+		fp.close();
+	}
+
+	void astc::load(const std::string &)
+	{
+		throw std::exception("astc loading isn't supported");
+	}
+
+	void astc::load(core::freader &)
+	{
+		throw std::exception("astc loading isn't supported");
+	}
+}
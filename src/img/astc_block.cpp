@@ -0,0 +1,1010 @@
+#include "block_internal.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <bitset>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define ASTC_SSE2 1
+#endif
+
+namespace
+{
+	using img::block::texels;
+	using img::block::max_texels;
+
+	///////////////////////////////////////////////////////////////////////////
+	//Integer sequence encoding
+
+	//A range of values, each stored as bits and a trit or a quint
+	struct ise_range
+	{
+		unsigned levels;
+		unsigned trits;
+		unsigned quints;
+		unsigned bits;
+	};
+
+	//Color endpoint ranges, smallest first
+	const ise_range color_ranges[] = {
+		{ 2, 0, 0, 1 }, { 3, 1, 0, 0 }, { 4, 0, 0, 2 }, { 5, 0, 1, 0 }, { 6, 1, 0, 1 }, { 8, 0, 0, 3 }, { 10, 0, 1, 1 },
+		{ 12, 1, 0, 2 }, { 16, 0, 0, 4 }, { 20, 0, 1, 2 }, { 24, 1, 0, 3 }, { 32, 0, 0, 5 }, { 40, 0, 1, 3 }, { 48, 1, 0, 4 },
+		{ 64, 0, 0, 6 }, { 80, 0, 1, 4 }, { 96, 1, 0, 5 }, { 128, 0, 0, 7 }, { 160, 0, 1, 5 }, { 192, 1, 0, 6 }, { 256, 0, 0, 8 },
+	};
+	const unsigned color_range_count = sizeof(color_ranges) / sizeof(color_ranges[0]);
+	//Smallest endpoint range decoders accept (6 levels)
+	const unsigned min_color_range = 4;
+
+	//Weight ranges by weight quantization mode
+	const ise_range weight_ranges[] = {
+		{ 2, 0, 0, 1 }, { 3, 1, 0, 0 }, { 4, 0, 0, 2 }, { 5, 0, 1, 0 }, { 6, 1, 0, 1 }, { 8, 0, 0, 3 },
+		{ 10, 0, 1, 1 }, { 12, 1, 0, 2 }, { 16, 0, 0, 4 }, { 20, 0, 1, 2 }, { 24, 1, 0, 3 }, { 32, 0, 0, 5 },
+	};
+	const unsigned weight_range_count = sizeof(weight_ranges) / sizeof(weight_ranges[0]);
+
+	//Layout of the B term of endpoint unquantization (9 bits, msb first, 'b' is bit 1 of the value)
+	//and the scale of the trit/quint, by the number of bits of the range
+	const char * const trit_layouts[7] = { "000000000", "000000000", "b000b0bb0", "cb000cbcb", "dcb000dcb", "edcb000ed", "fedcb000f" };
+	const unsigned trit_scales[7] = { 0, 204, 93, 44, 22, 11, 5 };
+	const char * const quint_layouts[6] = { "000000000", "000000000", "b0000bb00", "cb0000cbc", "dcb0000dc", "edcb0000e" };
+	const unsigned quint_scales[6] = { 0, 113, 54, 26, 13, 6 };
+
+	inline unsigned bit(unsigned value, unsigned index)
+	{
+		return (value >> index) & 1u;
+	}
+
+	unsigned ise_bits(const ise_range & range, unsigned count)
+	{
+		unsigned result = count * range.bits;
+		if (range.trits) result += (8 * count + 4) / 5;
+		if (range.quints) result += (7 * count + 2) / 3;
+		return result;
+	}
+
+	//Repeat the bits of a value to fill a wider one
+	unsigned replicate(unsigned value, unsigned bits, unsigned width)
+	{
+		unsigned result = 0;
+		int shift = (int)width - (int)bits;
+		for (; shift > 0; shift -= (int)bits)
+			result |= value << shift;
+
+		result |= value >> -shift;
+		return result & ((1u << width) - 1);
+	}
+
+	//5 trits packed in 8 bits
+	void decode_trits(unsigned packed, unsigned trits[5])
+	{
+		unsigned c;
+		if (((packed >> 2) & 7) == 7)
+		{
+			c = (((packed >> 5) & 7) << 2) | (packed & 3);
+			trits[4] = trits[3] = 2;
+		}
+		else
+		{
+			c = packed & 31;
+			if (((packed >> 5) & 3) == 3)
+			{
+				trits[4] = 2;
+				trits[3] = bit(packed, 7);
+			}
+			else
+			{
+				trits[4] = bit(packed, 7);
+				trits[3] = (packed >> 5) & 3;
+			}
+		}
+
+		if ((c & 3) == 3)
+		{
+			trits[2] = 2;
+			trits[1] = bit(c, 4);
+			trits[0] = (bit(c, 3) << 1) | (bit(c, 2) & ~bit(c, 3) & 1);
+		}
+		else if (((c >> 2) & 3) == 3)
+		{
+			trits[2] = trits[1] = 2;
+			trits[0] = c & 3;
+		}
+		else
+		{
+			trits[2] = bit(c, 4);
+			trits[1] = (c >> 2) & 3;
+			trits[0] = (bit(c, 1) << 1) | (bit(c, 0) & ~bit(c, 1) & 1);
+		}
+	}
+
+	//3 quints packed in 7 bits
+	void decode_quints(unsigned packed, unsigned quints[3])
+	{
+		if (((packed >> 1) & 3) == 3 && ((packed >> 5) & 3) == 0)
+		{
+			quints[2] = (bit(packed, 0) << 2) | ((bit(packed, 4) & ~bit(packed, 0) & 1) << 1) | (bit(packed, 3) & ~bit(packed, 0) & 1);
+			quints[1] = quints[0] = 4;
+			return;
+		}
+
+		unsigned c;
+		if (((packed >> 1) & 3) == 3)
+		{
+			quints[2] = 4;
+			c = (((packed >> 3) & 3) << 3) | ((~packed >> 4) & 6) | bit(packed, 0);
+		}
+		else
+		{
+			quints[2] = (packed >> 5) & 3;
+			c = packed & 31;
+		}
+
+		if ((c & 7) == 5)
+		{
+			quints[1] = 4;
+			quints[0] = (c >> 3) & 3;
+		}
+		else
+		{
+			quints[1] = (c >> 3) & 3;
+			quints[0] = c & 7;
+		}
+	}
+
+	//Endpoint value (0..255) of a quantized value
+	unsigned unquantize_color(const ise_range & range, unsigned value)
+	{
+		if (!range.trits && !range.quints)
+			return replicate(value, range.bits, 8);
+
+		unsigned low = value & ((1u << range.bits) - 1);
+		unsigned high = value >> range.bits;
+		const char * layout = range.trits ? trit_layouts[range.bits] : quint_layouts[range.bits];
+		unsigned scale = range.trits ? trit_scales[range.bits] : quint_scales[range.bits];
+
+		unsigned a = (low & 1) ? 0x1FF : 0;
+		unsigned b = 0;
+		for (unsigned i = 0; i < 9; ++i)
+			if (layout[i] != '0' && bit(low, layout[i] - 'a'))
+				b |= 1u << (8 - i);
+
+		unsigned t = (high * scale + b) ^ a;
+		return (a & 0x80) | (t >> 2);
+	}
+
+	//Weight (0..64) of a quantized value, only ranges without trits and quints are used
+	unsigned unquantize_weight(const ise_range & range, unsigned value)
+	{
+		unsigned result = replicate(value, range.bits, 6);
+		return result > 32 ? result + 1 : result;
+	}
+
+	//Lookup tables, built once
+	struct ise_tables
+	{
+		//Packing of every combination of 5 trits and 3 quints
+		uint8_t trit_codes[243];
+		uint8_t quint_codes[125];
+		//Endpoint value of every quantized value, and nearest quantized value of every endpoint value
+		uint8_t color_values[color_range_count][256];
+		uint8_t color_nearest[color_range_count][256];
+		//Weight of every quantized value, and nearest quantized value of every weight (0..64)
+		uint8_t weight_values[weight_range_count][32];
+		uint8_t weight_nearest[weight_range_count][65];
+
+		ise_tables()
+		{
+			//The smallest packing of a combination leaves the bits of missing trailing values zero
+			memset(trit_codes, 0xFF, sizeof(trit_codes));
+			memset(quint_codes, 0xFF, sizeof(quint_codes));
+			for (unsigned packed = 256; packed-- > 0; )
+			{
+				unsigned t[5];
+				decode_trits(packed, t);
+				trit_codes[t[0] + 3 * t[1] + 9 * t[2] + 27 * t[3] + 81 * t[4]] = (uint8_t)packed;
+			}
+
+			for (unsigned packed = 128; packed-- > 0; )
+			{
+				unsigned q[3];
+				decode_quints(packed, q);
+				quint_codes[q[0] + 5 * q[1] + 25 * q[2]] = (uint8_t)packed;
+			}
+
+			memset(color_values, 0, sizeof(color_values));
+			memset(color_nearest, 0, sizeof(color_nearest));
+			for (unsigned r = min_color_range; r < color_range_count; ++r)
+			{
+				for (unsigned v = 0; v < color_ranges[r].levels; ++v)
+					color_values[r][v] = (uint8_t)unquantize_color(color_ranges[r], v);
+
+				for (int target = 0; target < 256; ++target)
+				{
+					int best = 256;
+					for (unsigned v = 0; v < color_ranges[r].levels; ++v)
+					{
+						int diff = abs(color_values[r][v] - target);
+						if (diff < best)
+						{
+							best = diff;
+							color_nearest[r][target] = (uint8_t)v;
+						}
+					}
+				}
+			}
+
+			memset(weight_values, 0, sizeof(weight_values));
+			memset(weight_nearest, 0, sizeof(weight_nearest));
+			for (unsigned r = 0; r < weight_range_count; ++r)
+			{
+				const ise_range & range = weight_ranges[r];
+				if (range.trits || range.quints) continue;
+
+				for (unsigned v = 0; v < range.levels; ++v)
+					weight_values[r][v] = (uint8_t)unquantize_weight(range, v);
+
+				for (int target = 0; target <= 64; ++target)
+				{
+					int best = 65;
+					for (unsigned v = 0; v < range.levels; ++v)
+					{
+						int diff = abs(weight_values[r][v] - target);
+						if (diff < best)
+						{
+							best = diff;
+							weight_nearest[r][target] = (uint8_t)v;
+						}
+					}
+				}
+			}
+		}
+	};
+
+	const ise_tables & tables()
+	{
+		static const ise_tables instance;
+		return instance;
+	}
+
+	//Write a sequence, stopping after the bits a decoder reads for count values
+	void put_ise(unsigned char * out, unsigned & pos, const ise_range & range, const uint8_t * values, unsigned count)
+	{
+		static const unsigned trit_bits[5] = { 2, 2, 1, 2, 1 };
+		static const unsigned quint_bits[3] = { 3, 2, 2 };
+
+		const ise_tables & tab = tables();
+		const unsigned end = pos + ise_bits(range, count);
+		const unsigned mask = (1u << range.bits) - 1;
+		auto put = [&](unsigned value, unsigned bits)
+		{
+			bits = std::min(bits, end - pos);
+			img::block::put_bits(out, pos, value & ((1u << bits) - 1), bits);
+		};
+
+		unsigned group = range.trits ? 5 : (range.quints ? 3 : 1);
+		for (unsigned i = 0; i < count; i += group)
+		{
+			//Missing trailing values are zero
+			unsigned v[5] = { 0, 0, 0, 0, 0 };
+			for (unsigned j = 0; j < group && i + j < count; ++j)
+				v[j] = values[i + j];
+
+			if (range.trits)
+			{
+				unsigned packed = tab.trit_codes[(v[0] >> range.bits) + 3 * (v[1] >> range.bits) + 9 * (v[2] >> range.bits)
+					+ 27 * (v[3] >> range.bits) + 81 * (v[4] >> range.bits)];
+				for (unsigned j = 0, shift = 0; j < 5; shift += trit_bits[j++])
+				{
+					put(v[j] & mask, range.bits);
+					put(packed >> shift, trit_bits[j]);
+				}
+			}
+			else if (range.quints)
+			{
+				unsigned packed = tab.quint_codes[(v[0] >> range.bits) + 5 * (v[1] >> range.bits) + 25 * (v[2] >> range.bits)];
+				for (unsigned j = 0, shift = 0; j < 3; shift += quint_bits[j++])
+				{
+					put(v[j] & mask, range.bits);
+					put(packed >> shift, quint_bits[j]);
+				}
+			}
+			else
+			{
+				put(v[0], range.bits);
+			}
+		}
+
+		pos = end;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//Block layout
+
+	//Color endpoint modes (LDR, direct)
+	const unsigned cem_rgb = 8;
+	const unsigned cem_rgba = 12;
+
+	//Bits before the endpoints with one partition, and with several sharing a color endpoint mode
+	const unsigned header_bits_single = 17;
+	const unsigned header_bits_partitioned = 29;
+
+	//Weight count and bit limits of a block
+	const unsigned max_weights = 64;
+	const unsigned min_weight_bits = 24;
+	const unsigned max_weight_bits = 96;
+
+	//Cost of weight grids smaller than the block - they blur sprite edges, so coarser quantization usually wins
+	const float decimation_penalty = 3.0f;
+
+	//Weight grid of a 2D block mode, false for reserved and void extent modes
+	bool decode_block_mode(unsigned mode, unsigned & grid_w, unsigned & grid_h, unsigned & quant, bool & dual)
+	{
+		unsigned r = bit(mode, 4);
+		unsigned h = bit(mode, 9);
+		unsigned a = (mode >> 5) & 3;
+		dual = bit(mode, 10) != 0;
+
+		if ((mode & 3) != 0)
+		{
+			r |= (mode & 3) << 1;
+			unsigned b = (mode >> 7) & 3;
+			switch ((mode >> 2) & 3)
+			{
+			case 0: grid_w = b + 4; grid_h = a + 2; break;
+			case 1: grid_w = b + 8; grid_h = a + 2; break;
+			case 2: grid_w = a + 2; grid_h = b + 8; break;
+			default:
+				b &= 1;
+				if (mode & 0x100) { grid_w = b + 2; grid_h = a + 2; }
+				else { grid_w = a + 2; grid_h = b + 6; }
+				break;
+			}
+		}
+		else
+		{
+			r |= ((mode >> 2) & 3) << 1;
+			if (((mode >> 2) & 3) == 0) return false;
+
+			unsigned b = (mode >> 9) & 3;
+			switch ((mode >> 7) & 3)
+			{
+			case 0: grid_w = 12; grid_h = a + 2; break;
+			case 1: grid_w = a + 2; grid_h = 12; break;
+			case 2: grid_w = a + 6; grid_h = b + 6; dual = false; h = 0; break;
+			default:
+				if (a == 0) { grid_w = 6; grid_h = 10; }
+				else if (a == 1) { grid_w = 10; grid_h = 6; }
+				else return false;
+				break;
+			}
+		}
+
+		quant = r - 2 + 6 * h;
+		return true;
+	}
+
+	//Partition of a texel in a partitioning pattern (the pattern hash of the format)
+	unsigned partition_of(unsigned seed, unsigned x, unsigned y, unsigned partitions, bool small_block)
+	{
+		if (small_block)
+		{
+			x <<= 1;
+			y <<= 1;
+		}
+
+		seed += (partitions - 1) * 1024;
+
+		uint32_t rnum = seed;
+		rnum ^= rnum >> 15;
+		rnum *= 0xEEDE0891u;
+		rnum ^= rnum >> 5;
+		rnum += rnum << 16;
+		rnum ^= rnum >> 7;
+		rnum ^= rnum >> 3;
+		rnum ^= rnum << 6;
+		rnum ^= rnum >> 17;
+
+		unsigned seeds[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			seeds[i] = (rnum >> (4 * i)) & 0xF;
+			seeds[i] *= seeds[i];
+		}
+
+		unsigned sh1, sh2;
+		if (seed & 1)
+		{
+			sh1 = (seed & 2) ? 4 : 5;
+			sh2 = (partitions == 3) ? 6 : 5;
+		}
+		else
+		{
+			sh1 = (partitions == 3) ? 6 : 5;
+			sh2 = (seed & 2) ? 4 : 5;
+		}
+
+		for (int i = 0; i < 8; ++i)
+			seeds[i] >>= (i & 1) ? sh2 : sh1;
+
+		//2D blocks (z = 0)
+		int values[4] = {
+			(int)((seeds[0] * x + seeds[1] * y + (rnum >> 14)) & 0x3F),
+			(int)((seeds[2] * x + seeds[3] * y + (rnum >> 10)) & 0x3F),
+			(int)((seeds[4] * x + seeds[5] * y + (rnum >> 6)) & 0x3F),
+			(int)((seeds[6] * x + seeds[7] * y + (rnum >> 2)) & 0x3F),
+		};
+		if (partitions < 4) values[3] = 0;
+		if (partitions < 3) values[2] = 0;
+
+		if (values[0] >= values[1] && values[0] >= values[2] && values[0] >= values[3]) return 0;
+		if (values[1] >= values[2] && values[1] >= values[3]) return 1;
+		if (values[2] >= values[3]) return 2;
+		return 3;
+	}
+
+	//Grid weights a texel is interpolated from (spec bilinear infill)
+	struct infill
+	{
+		uint8_t index[4];
+		//Of 16
+		uint8_t weight[4];
+	};
+
+	//A way of encoding blocks of a footprint
+	struct config
+	{
+		unsigned grid_w, grid_h;
+		//Weight quantization mode
+		unsigned weight_quant;
+		unsigned partitions;
+		//Color endpoint mode
+		unsigned cem;
+		//Endpoint range the decoder derives from the remaining bits
+		unsigned color_range;
+		//11-bit block mode
+		unsigned mode;
+		//Estimated error, for ordering
+		float score;
+		//Infill of every texel, empty when the grid matches the block
+		std::vector<infill> fill;
+	};
+
+	//Candidate configurations and partitioning patterns of a footprint
+	struct footprint
+	{
+		unsigned width, height;
+		//Configurations best first, by [partitions - 1][cem == cem_rgba]
+		std::vector<config> configs[2][2];
+		//Texels in partition 1 of every distinct 2-partition pattern
+		std::vector<uint64_t> masks;
+		std::vector<unsigned> seeds;
+
+		footprint(unsigned w, unsigned h) : width(w), height(h)
+		{
+			//Block modes of every weight grid
+			unsigned modes[13][13][weight_range_count];
+			memset(modes, 0xFF, sizeof(modes));
+			for (unsigned mode = 0; mode < 2048; ++mode)
+			{
+				unsigned gw, gh, quant;
+				bool dual;
+				if (decode_block_mode(mode, gw, gh, quant, dual) && !dual && quant < weight_range_count && modes[gw][gh][quant] == ~0u)
+					modes[gw][gh][quant] = mode;
+			}
+
+			for (unsigned partitions = 1; partitions <= 2; ++partitions)
+			{
+				for (unsigned rgba = 0; rgba < 2; ++rgba)
+				{
+					unsigned cem = rgba ? cem_rgba : cem_rgb;
+					unsigned values = partitions * (rgba ? 8 : 6);
+					unsigned header = (partitions == 1) ? header_bits_single : header_bits_partitioned;
+
+					for (unsigned gw = 2; gw <= w; ++gw)
+					{
+						for (unsigned gh = 2; gh <= h; ++gh)
+						{
+							for (unsigned quant = 0; quant < weight_range_count; ++quant)
+							{
+								//Only weight ranges without trits and quints
+								const ise_range & range = weight_ranges[quant];
+								if (range.trits || range.quints || modes[gw][gh][quant] == ~0u) continue;
+
+								unsigned weight_bits = ise_bits(range, gw * gh);
+								if (gw * gh > max_weights || weight_bits < min_weight_bits || weight_bits > max_weight_bits) continue;
+								if (header + weight_bits >= 128) continue;
+
+								//The decoder uses the largest endpoint range that fits
+								unsigned endpoint_bits = 128 - header - weight_bits;
+								unsigned color_range = color_range_count;
+								for (unsigned r = color_range_count; r-- > 0; )
+								{
+									if (ise_bits(color_ranges[r], values) <= endpoint_bits)
+									{
+										color_range = r;
+										break;
+									}
+								}
+
+								if (color_range >= color_range_count || color_range < min_color_range) continue;
+
+								config cfg;
+								cfg.grid_w = gw;
+								cfg.grid_h = gh;
+								cfg.weight_quant = quant;
+								cfg.partitions = partitions;
+								cfg.cem = cem;
+								cfg.color_range = color_range;
+								cfg.mode = modes[gw][gh][quant];
+
+								float weight_step = 1.0f / (range.levels - 1);
+								float color_step = 1.0f / (color_ranges[color_range].levels - 1);
+								float decimation = 1.0f - (float)(gw * gh) / (w * h);
+								cfg.score = weight_step * weight_step + color_step * color_step + decimation_penalty * decimation;
+								if (gw != w || gh != h) build_infill(cfg);
+								configs[partitions - 1][rgba].push_back(cfg);
+							}
+						}
+					}
+
+					auto & list = configs[partitions - 1][rgba];
+					std::stable_sort(list.begin(), list.end(), [](const config & a, const config & b) { return a.score < b.score; });
+				}
+			}
+
+			//Distinct patterns that use both partitions (a pattern and its complement are the same)
+			uint64_t all = (w * h == 64) ? ~0ull : ((1ull << (w * h)) - 1);
+			for (unsigned seed = 0; seed < 1024; ++seed)
+			{
+				uint64_t mask = 0;
+				for (unsigned y = 0; y < h; ++y)
+					for (unsigned x = 0; x < w; ++x)
+						if (partition_of(seed, x, y, 2, w * h < 31) == 1)
+							mask |= 1ull << (y * w + x);
+
+				if (mask == 0 || mask == all) continue;
+				if (std::find(masks.begin(), masks.end(), mask) != masks.end()) continue;
+				if (std::find(masks.begin(), masks.end(), mask ^ all) != masks.end()) continue;
+
+				masks.push_back(mask);
+				seeds.push_back(seed);
+			}
+		}
+
+		void build_infill(config & cfg) const
+		{
+			unsigned ds = (1024 + width / 2) / (width - 1);
+			unsigned dt = (1024 + height / 2) / (height - 1);
+
+			cfg.fill.resize(width * height);
+			for (unsigned t = 0; t < height; ++t)
+			{
+				for (unsigned s = 0; s < width; ++s)
+				{
+					unsigned gs = (ds * s * (cfg.grid_w - 1) + 32) >> 6;
+					unsigned gt = (dt * t * (cfg.grid_h - 1) + 32) >> 6;
+					unsigned fs = gs & 15, ft = gt & 15;
+					unsigned v0 = (gs >> 4) + (gt >> 4) * cfg.grid_w;
+
+					unsigned w11 = (fs * ft + 8) >> 4;
+					const unsigned weights[4] = { 16 - fs - ft + w11, fs - w11, ft - w11, w11 };
+					const unsigned indices[4] = { v0, v0 + 1, v0 + cfg.grid_w, v0 + cfg.grid_w + 1 };
+
+					infill & fill = cfg.fill[t * width + s];
+					for (int k = 0; k < 4; ++k)
+					{
+						fill.weight[k] = (uint8_t)weights[k];
+						//Unused neighbours may lie past the grid
+						fill.index[k] = (uint8_t)(weights[k] ? indices[k] : v0);
+					}
+				}
+			}
+		}
+	};
+
+	const footprint & footprint_tables(unsigned width, unsigned height)
+	{
+		static const footprint f4(4, 4), f6(6, 6), f8(8, 8);
+		if (width == 4 && height == 4) return f4;
+		if (width == 6 && height == 6) return f6;
+		if (width == 8 && height == 8) return f8;
+		throw std::exception("unsupported astc footprint");
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//Encoding
+
+	//Weighted squared error of decoded texels (one array per channel)
+	float block_error(const texels & px, const float (*decoded)[max_texels])
+	{
+#ifdef ASTC_SSE2
+		__m128 total = _mm_setzero_ps();
+		for (unsigned i = 0; i < px.count; i += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 diff = _mm_sub_ps(_mm_loadu_ps(&px.ch[c][i]), _mm_loadu_ps(&decoded[c][i]));
+				sum = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+			}
+
+			total = _mm_add_ps(total, _mm_mul_ps(sum, _mm_loadu_ps(&px.weight[i])));
+		}
+
+		float sums[4];
+		_mm_storeu_ps(sums, total);
+		return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+		float total = 0.0f;
+		for (unsigned i = 0; i < px.count; ++i)
+		{
+			float sum = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				float diff = px.ch[c][i] - decoded[c][i];
+				sum += diff * diff;
+			}
+
+			total += sum * px.weight[i];
+		}
+
+		return total;
+#endif
+	}
+
+	//Grid weights whose infill comes closest to the ideal texel weights
+	void decimate(const config & cfg, const float * ideal, unsigned count, float * grid)
+	{
+		unsigned grid_count = cfg.grid_w * cfg.grid_h;
+		if (cfg.fill.empty())
+		{
+			memcpy(grid, ideal, grid_count * sizeof(float));
+			return;
+		}
+
+		//Start from the average of the texels each weight reaches, then correct twice
+		float sum[max_weights], total[max_weights], current[max_texels];
+		for (int step = 0; step < 3; ++step)
+		{
+			for (unsigned j = 0; j < grid_count; ++j)
+				sum[j] = total[j] = 0.0f;
+
+			for (unsigned i = 0; i < count; ++i)
+			{
+				const infill & fill = cfg.fill[i];
+				float residual = ideal[i];
+				if (step > 0)
+				{
+					current[i] = 0.0f;
+					for (int k = 0; k < 4; ++k)
+						current[i] += grid[fill.index[k]] * fill.weight[k];
+					residual -= current[i] / 16.0f;
+				}
+
+				for (int k = 0; k < 4; ++k)
+				{
+					sum[fill.index[k]] += residual * fill.weight[k];
+					total[fill.index[k]] += fill.weight[k];
+				}
+			}
+
+			for (unsigned j = 0; j < grid_count; ++j)
+			{
+				float value = total[j] > 0.0f ? sum[j] / total[j] : 0.5f;
+				grid[j] = (step == 0) ? value : std::min(std::max(grid[j] + value, 0.0f), 1.0f);
+			}
+		}
+	}
+
+	//Raise the second endpoint until it isn't darker than the first (darker ones mean blue contraction)
+	void order_endpoints(const ise_tables & tab, unsigned range, uint8_t q0[4], uint8_t q1[4])
+	{
+		auto brightness = [&](const uint8_t * q)
+		{
+			return tab.color_values[range][q[0]] + tab.color_values[range][q[1]] + tab.color_values[range][q[2]];
+		};
+
+		while (brightness(q1) < brightness(q0))
+		{
+			//Step the channel with the most room to the next value up, or the first endpoint down
+			int best = -1;
+			unsigned best_value = 256;
+			for (int c = 0; c < 3; ++c)
+			{
+				unsigned current = tab.color_values[range][q1[c]];
+				for (unsigned v = 0; v < color_ranges[range].levels; ++v)
+				{
+					unsigned value = tab.color_values[range][v];
+					if (value > current && value - current < best_value)
+					{
+						best_value = value - current;
+						best = c * 256 + (int)v;
+					}
+				}
+			}
+
+			if (best < 0)
+			{
+				for (int c = 0; c < 3; ++c)
+					q0[c] = tab.color_nearest[range][0];
+				break;
+			}
+
+			q1[best / 256] = (uint8_t)(best % 256);
+		}
+	}
+
+	//Encode a block with one configuration and partitioning, returns the error
+	float encode_config(const texels & px, const config & cfg, unsigned seed, uint64_t mask, img::encode_quality quality, unsigned char * out)
+	{
+		const ise_tables & tab = tables();
+		const ise_range & wrange = weight_ranges[cfg.weight_quant];
+		const unsigned channels = (cfg.cem == cem_rgba) ? 4 : 3;
+		const unsigned count = px.count;
+		const unsigned grid_count = cfg.grid_w * cfg.grid_h;
+
+		//Texels of every partition (the others weigh nothing)
+		texels part[2];
+		unsigned char partition[max_texels];
+		for (unsigned i = 0; i < count; ++i)
+			partition[i] = (unsigned char)((mask >> i) & 1);
+
+		float e0[2][4], e1[2][4];
+		for (unsigned p = 0; p < cfg.partitions; ++p)
+		{
+			part[p] = px;
+			for (unsigned i = 0; i < count; ++i)
+				if (partition[i] != p) part[p].weight[i] = 0.0f;
+
+			img::block::principal_endpoints(part[p], channels, e0[p], e1[p]);
+			if (e1[p][0] + e1[p][1] + e1[p][2] < e0[p][0] + e0[p][1] + e0[p][2])
+				for (int c = 0; c < 4; ++c) std::swap(e0[p][c], e1[p][c]);
+		}
+
+		unsigned char identity[max_texels];
+		float ideal[max_texels], grid[max_weights], fractions[max_texels];
+		uint8_t grid_values[max_weights];
+		unsigned texel_weights[max_texels];
+
+		int refits = (quality == img::quality_fast) ? 0 : (quality == img::quality_normal ? 1 : 2);
+		for (int pass = 0; ; ++pass)
+		{
+			//Position of every texel along its partition's line
+			for (unsigned i = 0; i < count; ++i)
+			{
+				const float * a = e0[partition[i]];
+				const float * b = e1[partition[i]];
+				float dot = 0.0f, length = 0.0f;
+				for (unsigned c = 0; c < channels; ++c)
+				{
+					dot += (px.ch[c][i] - a[c]) * (b[c] - a[c]);
+					length += (b[c] - a[c]) * (b[c] - a[c]);
+				}
+
+				ideal[i] = length > 0.0f ? std::min(std::max(dot / length, 0.0f), 1.0f) : 0.0f;
+			}
+
+			decimate(cfg, ideal, count, grid);
+			for (unsigned j = 0; j < grid_count; ++j)
+				grid_values[j] = tab.weight_nearest[cfg.weight_quant][(int)floorf(grid[j] * 64.0f + 0.5f)];
+
+			for (unsigned i = 0; i < count; ++i)
+			{
+				if (cfg.fill.empty())
+				{
+					texel_weights[i] = tab.weight_values[cfg.weight_quant][grid_values[i]];
+					continue;
+				}
+
+				const infill & fill = cfg.fill[i];
+				unsigned sum = 8;
+				for (int k = 0; k < 4; ++k)
+					sum += tab.weight_values[cfg.weight_quant][grid_values[fill.index[k]]] * fill.weight[k];
+				texel_weights[i] = sum >> 4;
+			}
+
+			if (pass == refits) break;
+
+			//Endpoints that best fit the quantized weights
+			for (unsigned i = 0; i < count; ++i)
+			{
+				identity[i] = (unsigned char)i;
+				fractions[i] = texel_weights[i] / 64.0f;
+			}
+
+			for (unsigned p = 0; p < cfg.partitions; ++p)
+				img::block::fit_endpoints(part[p], identity, fractions, channels, e0[p], e1[p]);
+		}
+
+		//Quantize the endpoints (RGB endpoints are opaque)
+		uint8_t q0[2][4], q1[2][4];
+		for (unsigned p = 0; p < cfg.partitions; ++p)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				q0[p][c] = tab.color_nearest[cfg.color_range][(int)floorf(e0[p][c] + 0.5f)];
+				q1[p][c] = tab.color_nearest[cfg.color_range][(int)floorf(e1[p][c] + 0.5f)];
+			}
+
+			order_endpoints(tab, cfg.color_range, q0[p], q1[p]);
+		}
+
+		//Decode as a decoder would, 16-bit interpolation
+		float decoded[4][max_texels];
+		for (unsigned i = 0; i < count; ++i)
+		{
+			unsigned p = partition[i];
+			unsigned w = texel_weights[i];
+			for (unsigned c = 0; c < 4; ++c)
+			{
+				unsigned a = (c < channels) ? tab.color_values[cfg.color_range][q0[p][c]] : 255;
+				unsigned b = (c < channels) ? tab.color_values[cfg.color_range][q1[p][c]] : 255;
+				unsigned value = (a * 257 * (64 - w) + b * 257 * w + 32) >> 6;
+				decoded[c][i] = (float)(value >> 8);
+			}
+		}
+
+		//Pack - header and endpoints from the bottom, weights bit reversed from the top
+		memset(out, 0, 16);
+		unsigned pos = 0;
+		img::block::put_bits(out, pos, cfg.mode, 11);
+		img::block::put_bits(out, pos, cfg.partitions - 1, 2);
+		if (cfg.partitions == 1)
+		{
+			img::block::put_bits(out, pos, cfg.cem, 4);
+		}
+		else
+		{
+			img::block::put_bits(out, pos, seed, 10);
+			img::block::put_bits(out, pos, cfg.cem << 2, 6);
+		}
+
+		uint8_t values[16];
+		unsigned value_count = 0;
+		for (unsigned p = 0; p < cfg.partitions; ++p)
+		{
+			for (unsigned c = 0; c < channels; ++c)
+			{
+				values[value_count++] = q0[p][c];
+				values[value_count++] = q1[p][c];
+			}
+		}
+
+		put_ise(out, pos, color_ranges[cfg.color_range], values, value_count);
+
+		unsigned char weight_bits[16] = { };
+		unsigned weight_pos = 0;
+		put_ise(weight_bits, weight_pos, wrange, grid_values, grid_count);
+		for (unsigned k = 0; k < weight_pos; ++k)
+			if (bit(weight_bits[k / 8], k % 8))
+				out[(127 - k) / 8] |= (unsigned char)(1u << ((127 - k) % 8));
+
+		return block_error(px, decoded);
+	}
+
+	//Constant color block
+	void encode_void_extent(const texels & px, unsigned char * out)
+	{
+		//Void extent mode, LDR, no extent coordinates (all ones)
+		out[0] = 0xFC;
+		out[1] = 0xFD;
+		memset(out + 2, 0xFF, 6);
+		for (int c = 0; c < 4; ++c)
+		{
+			unsigned value = (unsigned)floorf(px.ch[c][0] + 0.5f) * 257;
+			out[8 + c * 2] = (unsigned char)value;
+			out[9 + c * 2] = (unsigned char)(value >> 8);
+		}
+	}
+
+	//Texels of the second cluster of a 2-means split
+	uint64_t split_texels(const texels & px, unsigned channels)
+	{
+		float centers[2][4];
+		img::block::principal_endpoints(px, channels, centers[0], centers[1]);
+
+		uint64_t mask = 0;
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			mask = 0;
+			float sum[2][4] = { }, total[2] = { 0.0f, 0.0f };
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				float dist[2] = { 0.0f, 0.0f };
+				for (int k = 0; k < 2; ++k)
+					for (unsigned c = 0; c < channels; ++c)
+						dist[k] += (px.ch[c][i] - centers[k][c]) * (px.ch[c][i] - centers[k][c]);
+
+				unsigned k = dist[1] < dist[0] ? 1 : 0;
+				if (k) mask |= 1ull << i;
+				for (unsigned c = 0; c < channels; ++c)
+					sum[k][c] += px.ch[c][i];
+				total[k] += 1.0f;
+			}
+
+			if (total[0] == 0.0f || total[1] == 0.0f) break;
+			for (int k = 0; k < 2; ++k)
+				for (unsigned c = 0; c < channels; ++c)
+					centers[k][c] = sum[k][c] / total[k];
+		}
+
+		return mask;
+	}
+}
+
+namespace img
+{
+	namespace block
+	{
+		void encode_astc(const texels & px, unsigned width, unsigned height, encode_quality quality, unsigned char * out)
+		{
+			const footprint & fp = footprint_tables(width, height);
+
+			bool constant = true, opaque = true;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				opaque = opaque && px.ch[3][i] >= 255.0f;
+				for (int c = 0; c < 4; ++c)
+					constant = constant && px.ch[c][i] == px.ch[c][0];
+			}
+
+			if (constant)
+			{
+				encode_void_extent(px, out);
+				return;
+			}
+
+			//Opaque blocks spend no bits on alpha
+			unsigned rgba = opaque ? 0 : 1;
+			unsigned single_tries = (quality == quality_fast) ? 1 : (quality == quality_normal ? 2 : 4);
+			unsigned pattern_tries = (quality == quality_fast) ? 0 : (quality == quality_normal ? 2 : 8);
+			unsigned partitioned_tries = (quality == quality_best) ? 2 : 1;
+
+			float best = FLT_MAX;
+			unsigned char candidate[16];
+			const auto & single = fp.configs[0][rgba];
+			for (unsigned k = 0; k < single_tries && k < single.size(); ++k)
+			{
+				float error = encode_config(px, single[k], 0, 0, quality, candidate);
+				if (error < best)
+				{
+					best = error;
+					memcpy(out, candidate, 16);
+				}
+			}
+
+			const auto & partitioned = fp.configs[1][rgba];
+			if (pattern_tries == 0 || partitioned.empty() || best <= 0.0f) return;
+
+			//Patterns closest to a 2-means split of the texels, by the number of texels on the wrong side
+			uint64_t ideal = split_texels(px, opaque ? 3 : 4);
+			std::vector<std::pair<unsigned, size_t>> ranked(fp.masks.size());
+			for (size_t m = 0; m < fp.masks.size(); ++m)
+			{
+				unsigned wrong = (unsigned)std::bitset<64>(fp.masks[m] ^ ideal).count();
+				ranked[m] = std::make_pair(std::min(wrong, px.count - wrong), m);
+			}
+
+			pattern_tries = std::min<unsigned>(pattern_tries, (unsigned)ranked.size());
+			std::partial_sort(ranked.begin(), ranked.begin() + pattern_tries, ranked.end());
+
+			for (unsigned t = 0; t < pattern_tries; ++t)
+			{
+				size_t m = ranked[t].second;
+				for (unsigned k = 0; k < partitioned_tries && k < partitioned.size(); ++k)
+				{
+					float error = encode_config(px, partitioned[k], fp.seeds[m], fp.masks[m], quality, candidate);
+					if (error < best)
+					{
+						best = error;
+						memcpy(out, candidate, 16);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,688 @@
+#include "block_internal.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	using img::block::texels;
+
+	//Only RGB matters for color blocks, only alpha for alpha blocks
+	const float rgb_weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	const float alpha_weights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float rgba_weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	//Fraction of the way from c0 to c1 of every BC1 index
+	const float bc1_fractions4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	const float bc1_fractions3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+	//BC7 4-bit index weights (of 64)
+	const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	//BC7 2-bit index weights (of 64)
+	const int bc7_weights2[4] = { 0, 21, 43, 64 };
+
+	int round_channel(float value, int max)
+	{
+		int result = (int)floorf(value * max / 255.0f + 0.5f);
+		return result < 0 ? 0 : (result > max ? max : result);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//BC1 color
+
+	uint16_t to565(const float c[4])
+	{
+		return (uint16_t)((round_channel(c[0], 31) << 11) | (round_channel(c[1], 63) << 5) | round_channel(c[2], 31));
+	}
+
+	void from565(unsigned value, float c[4])
+	{
+		unsigned r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+		c[0] = (float)((r << 3) | (r >> 2));
+		c[1] = (float)((g << 2) | (g >> 4));
+		c[2] = (float)((b << 3) | (b >> 2));
+		c[3] = 255.0f;
+	}
+
+	float bc1_evaluate(const texels & px, unsigned q0, unsigned q1, bool three_color, unsigned char * indices)
+	{
+		float palette[4][4];
+		from565(q0, palette[0]);
+		from565(q1, palette[1]);
+
+		const float * fractions = three_color ? bc1_fractions3 : bc1_fractions4;
+		unsigned entries = three_color ? 3 : 4;
+		for (unsigned k = 2; k < entries; ++k)
+			for (int c = 0; c < 4; ++c)
+				palette[k][c] = palette[0][c] + (palette[1][c] - palette[0][c]) * fractions[k];
+
+		return img::block::nearest(px, palette, entries, rgb_weights, indices);
+	}
+
+	//Step one 565 component of an endpoint
+	bool step565(unsigned & value, int component, int delta)
+	{
+		static const unsigned shifts[3] = { 11, 5, 0 };
+		static const unsigned maxes[3] = { 31, 63, 31 };
+
+		int current = (int)((value >> shifts[component]) & maxes[component]);
+		int next = current + delta;
+		if (next < 0 || next > (int)maxes[component]) return false;
+
+		value = (value & ~(maxes[component] << shifts[component])) | ((unsigned)next << shifts[component]);
+		return true;
+	}
+
+	//Color half of BC1/BC3 blocks - three_color blocks use index 3 for transparent texels (weight 0)
+	void encode_color(const texels & px, img::encode_quality quality, bool three_color, unsigned char * out)
+	{
+		float e0[4], e1[4];
+		if (quality == img::quality_fast)
+			img::block::bounds(px, 3, e1, e0);
+		else
+			img::block::principal_endpoints(px, 3, e0, e1);
+
+		unsigned best0 = to565(e0), best1 = to565(e1);
+		unsigned char best[img::block::max_texels], indices[img::block::max_texels];
+		float best_error = bc1_evaluate(px, best0, best1, three_color, best);
+
+		//Refit the endpoints to the chosen indices until it stops helping
+		int iterations = (quality == img::quality_fast) ? 0 : (quality == img::quality_normal ? 2 : 6);
+		const float * fractions = three_color ? bc1_fractions3 : bc1_fractions4;
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			if (!img::block::fit_endpoints(px, best, fractions, 3, e0, e1))
+				break;
+
+			unsigned q0 = to565(e0), q1 = to565(e1);
+			if (q0 == best0 && q1 == best1)
+				break;
+
+			float error = bc1_evaluate(px, q0, q1, three_color, indices);
+			if (error >= best_error)
+				break;
+
+			best0 = q0;
+			best1 = q1;
+			best_error = error;
+			memcpy(best, indices, px.count);
+		}
+
+		//Try every single step around the endpoints
+		for (int pass = 0; quality == img::quality_best && pass < 4; ++pass)
+		{
+			bool improved = false;
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				for (int component = 0; component < 3; ++component)
+				{
+					for (int delta = -1; delta <= 1; delta += 2)
+					{
+						unsigned q0 = best0, q1 = best1;
+						if (!step565(endpoint == 0 ? q0 : q1, component, delta))
+							continue;
+
+						float error = bc1_evaluate(px, q0, q1, three_color, indices);
+						if (error < best_error)
+						{
+							best0 = q0;
+							best1 = q1;
+							best_error = error;
+							memcpy(best, indices, px.count);
+							improved = true;
+						}
+					}
+				}
+			}
+
+			if (!improved) break;
+		}
+
+		//The endpoint order selects the mode - c0 > c1 for four colors, c0 <= c1 for three
+		if (!three_color && best0 == best1)
+			memset(best, 0, px.count);
+		else if (!three_color && best0 < best1)
+		{
+			static const unsigned char swap4[4] = { 1, 0, 3, 2 };
+			std::swap(best0, best1);
+			for (unsigned i = 0; i < px.count; ++i) best[i] = swap4[best[i]];
+		}
+		else if (three_color && best0 > best1)
+		{
+			static const unsigned char swap3[4] = { 1, 0, 2, 3 };
+			std::swap(best0, best1);
+			for (unsigned i = 0; i < px.count; ++i) best[i] = swap3[best[i]];
+		}
+
+		uint32_t bits = 0;
+		for (unsigned i = 0; i < 16; ++i)
+		{
+			unsigned index = (three_color && px.weight[i] <= 0.0f) ? 3 : best[i];
+			bits |= index << (i * 2);
+		}
+
+		out[0] = (unsigned char)best0;
+		out[1] = (unsigned char)(best0 >> 8);
+		out[2] = (unsigned char)best1;
+		out[3] = (unsigned char)(best1 >> 8);
+		out[4] = (unsigned char)bits;
+		out[5] = (unsigned char)(bits >> 8);
+		out[6] = (unsigned char)(bits >> 16);
+		out[7] = (unsigned char)(bits >> 24);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//BC3 alpha
+
+	//a0 > a1 interpolates 8 values, otherwise 6 values plus 0 and 255
+	float alpha_evaluate(const texels & px, int a0, int a1, unsigned char * indices)
+	{
+		float palette[8][4] = { };
+		palette[0][3] = (float)a0;
+		palette[1][3] = (float)a1;
+		if (a0 > a1)
+		{
+			for (int k = 2; k < 8; ++k)
+				palette[k][3] = (float)(((8 - k) * a0 + (k - 1) * a1) / 7);
+		}
+		else
+		{
+			for (int k = 2; k < 6; ++k)
+				palette[k][3] = (float)(((6 - k) * a0 + (k - 1) * a1) / 5);
+			palette[6][3] = 0.0f;
+			palette[7][3] = 255.0f;
+		}
+
+		return img::block::nearest(px, palette, 8, alpha_weights, indices);
+	}
+
+	void encode_alpha(const texels & px, img::encode_quality quality, unsigned char * out)
+	{
+		float low[4], high[4];
+		img::block::bounds(px, 4, low, high);
+
+		int best0 = (int)high[3], best1 = (int)low[3];
+		unsigned char best[img::block::max_texels], indices[img::block::max_texels];
+		float best_error = alpha_evaluate(px, best0, best1, best);
+
+		//Six value mode spends no interpolated values on fully transparent and opaque texels
+		if (quality != img::quality_fast)
+		{
+			int inner_low = 255, inner_high = 0;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				int a = (int)px.ch[3][i];
+				if (a == 0 || a == 255) continue;
+				inner_low = std::min(inner_low, a);
+				inner_high = std::max(inner_high, a);
+			}
+
+			if (inner_low <= inner_high)
+			{
+				float error = alpha_evaluate(px, inner_low, inner_high, indices);
+				if (error < best_error)
+				{
+					best0 = inner_low;
+					best1 = inner_high;
+					best_error = error;
+					memcpy(best, indices, px.count);
+				}
+			}
+		}
+
+		//Try every single step around the endpoints (keeping the mode)
+		for (int pass = 0; quality == img::quality_best && pass < 8; ++pass)
+		{
+			bool improved = false;
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				for (int delta = -1; delta <= 1; delta += 2)
+				{
+					int a0 = best0 + (endpoint == 0 ? delta : 0);
+					int a1 = best1 + (endpoint == 1 ? delta : 0);
+					if (a0 < 0 || a0 > 255 || a1 < 0 || a1 > 255 || ((a0 > a1) != (best0 > best1)))
+						continue;
+
+					float error = alpha_evaluate(px, a0, a1, indices);
+					if (error < best_error)
+					{
+						best0 = a0;
+						best1 = a1;
+						best_error = error;
+						memcpy(best, indices, px.count);
+						improved = true;
+					}
+				}
+			}
+
+			if (!improved) break;
+		}
+
+		memset(out, 0, 8);
+		out[0] = (unsigned char)best0;
+		out[1] = (unsigned char)best1;
+
+		unsigned pos = 16;
+		for (unsigned i = 0; i < 16; ++i)
+			img::block::put_bits(out, pos, best[i], 3);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//BC7 mode 6 (one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices)
+	//and mode 5 (7.7.7 color and 8-bit alpha endpoints, 2-bit color and alpha indices)
+
+	struct bc7_endpoints
+	{
+		//7-bit values
+		int value[2][4];
+		//p-bits
+		int pbit[2];
+	};
+
+	void bc7_quantize(const float e[4], int pbit, int value[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			int v = (int)floorf((e[c] - pbit) / 2.0f + 0.5f);
+			value[c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+		}
+	}
+
+	//Quantization error of an endpoint with a p-bit
+	float bc7_quantize_error(const float e[4], int pbit)
+	{
+		int value[4];
+		bc7_quantize(e, pbit, value);
+
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			float d = e[c] - (float)((value[c] << 1) | pbit);
+			error += d * d;
+		}
+
+		return error;
+	}
+
+	float bc7_evaluate(const texels & px, const bc7_endpoints & ep, unsigned char * indices)
+	{
+		int e0[4], e1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			e0[c] = (ep.value[0][c] << 1) | ep.pbit[0];
+			e1[c] = (ep.value[1][c] << 1) | ep.pbit[1];
+		}
+
+		float palette[16][4];
+		for (int k = 0; k < 16; ++k)
+			for (int c = 0; c < 4; ++c)
+				palette[k][c] = (float)(((64 - bc7_weights[k]) * e0[c] + bc7_weights[k] * e1[c] + 32) >> 6);
+
+		return img::block::nearest(px, palette, 16, rgba_weights, indices);
+	}
+
+	//Best p-bits for a pair of endpoints
+	float bc7_choose(const texels & px, const float e0[4], const float e1[4], img::encode_quality quality, bc7_endpoints & ep, unsigned char * indices)
+	{
+		if (quality == img::quality_fast)
+		{
+			ep.pbit[0] = bc7_quantize_error(e0, 1) < bc7_quantize_error(e0, 0) ? 1 : 0;
+			ep.pbit[1] = bc7_quantize_error(e1, 1) < bc7_quantize_error(e1, 0) ? 1 : 0;
+			bc7_quantize(e0, ep.pbit[0], ep.value[0]);
+			bc7_quantize(e1, ep.pbit[1], ep.value[1]);
+			return bc7_evaluate(px, ep, indices);
+		}
+
+		float best_error = FLT_MAX;
+		unsigned char candidate[img::block::max_texels];
+		for (int pbits = 0; pbits < 4; ++pbits)
+		{
+			bc7_endpoints trial;
+			trial.pbit[0] = pbits & 1;
+			trial.pbit[1] = pbits >> 1;
+			bc7_quantize(e0, trial.pbit[0], trial.value[0]);
+			bc7_quantize(e1, trial.pbit[1], trial.value[1]);
+
+			float error = bc7_evaluate(px, trial, candidate);
+			if (error < best_error)
+			{
+				best_error = error;
+				ep = trial;
+				memcpy(indices, candidate, px.count);
+			}
+		}
+
+		return best_error;
+	}
+
+	//Mode 6 block, returns its error
+	float bc7_mode6(const texels & px, img::encode_quality quality, unsigned char * out)
+	{
+		float e0[4], e1[4];
+		if (quality == img::quality_fast)
+			img::block::bounds(px, 4, e0, e1);
+		else
+			img::block::principal_endpoints(px, 4, e0, e1);
+
+		bc7_endpoints best;
+		unsigned char indices[img::block::max_texels], candidate[img::block::max_texels];
+		float best_error = bc7_choose(px, e0, e1, quality, best, indices);
+
+		float fractions[16];
+		for (int k = 0; k < 16; ++k)
+			fractions[k] = bc7_weights[k] / 64.0f;
+
+		int iterations = (quality == img::quality_fast) ? 0 : (quality == img::quality_normal ? 2 : 6);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			if (!img::block::fit_endpoints(px, indices, fractions, 4, e0, e1))
+				break;
+
+			bc7_endpoints trial;
+			float error = bc7_choose(px, e0, e1, quality, trial, candidate);
+			if (error >= best_error)
+				break;
+
+			best = trial;
+			best_error = error;
+			memcpy(indices, candidate, px.count);
+		}
+
+		//Try every single step around the endpoints
+		for (int pass = 0; quality == img::quality_best && pass < 4; ++pass)
+		{
+			bool improved = false;
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					for (int delta = -1; delta <= 1; delta += 2)
+					{
+						bc7_endpoints trial = best;
+						int & value = trial.value[endpoint][c];
+						value += delta;
+						if (value < 0 || value > 127) continue;
+
+						float error = bc7_evaluate(px, trial, candidate);
+						if (error < best_error)
+						{
+							best = trial;
+							best_error = error;
+							memcpy(indices, candidate, px.count);
+							improved = true;
+						}
+					}
+				}
+			}
+
+			if (!improved) break;
+		}
+
+		//The first index has an implicit 0 top bit - swap the endpoints if it's set
+		if (indices[0] >= 8)
+		{
+			for (int c = 0; c < 4; ++c)
+				std::swap(best.value[0][c], best.value[1][c]);
+			std::swap(best.pbit[0], best.pbit[1]);
+			for (unsigned i = 0; i < 16; ++i)
+				indices[i] = (unsigned char)(15 - indices[i]);
+		}
+
+		memset(out, 0, 16);
+		unsigned pos = 0;
+		img::block::put_bits(out, pos, 1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			img::block::put_bits(out, pos, best.value[0][c], 7);
+			img::block::put_bits(out, pos, best.value[1][c], 7);
+		}
+		img::block::put_bits(out, pos, best.pbit[0], 1);
+		img::block::put_bits(out, pos, best.pbit[1], 1);
+
+		img::block::put_bits(out, pos, indices[0], 3);
+		for (unsigned i = 1; i < 16; ++i)
+			img::block::put_bits(out, pos, indices[i], 4);
+
+		return best_error;
+	}
+
+	//Mode 5 endpoints (7-bit RGB, 8-bit alpha)
+	struct bc7_separate
+	{
+		int rgb[2][3];
+		int alpha[2];
+	};
+
+	float bc7_rgb_evaluate(const texels & px, const int rgb[2][3], unsigned char * indices)
+	{
+		float palette[4][4] = { };
+		for (int k = 0; k < 4; ++k)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				int e0 = (rgb[0][c] << 1) | (rgb[0][c] >> 6);
+				int e1 = (rgb[1][c] << 1) | (rgb[1][c] >> 6);
+				palette[k][c] = (float)(((64 - bc7_weights2[k]) * e0 + bc7_weights2[k] * e1 + 32) >> 6);
+			}
+		}
+
+		return img::block::nearest(px, palette, 4, rgb_weights, indices);
+	}
+
+	float bc7_alpha_evaluate(const texels & px, const int alpha[2], unsigned char * indices)
+	{
+		float palette[4][4] = { };
+		for (int k = 0; k < 4; ++k)
+			palette[k][3] = (float)(((64 - bc7_weights2[k]) * alpha[0] + bc7_weights2[k] * alpha[1] + 32) >> 6);
+
+		return img::block::nearest(px, palette, 4, alpha_weights, indices);
+	}
+
+	//Mode 5 block (separate color and alpha indices), returns its error
+	float bc7_mode5(const texels & px, img::encode_quality quality, unsigned char * out)
+	{
+		float fractions[4];
+		for (int k = 0; k < 4; ++k)
+			fractions[k] = bc7_weights2[k] / 64.0f;
+
+		int iterations = (quality == img::quality_fast) ? 0 : (quality == img::quality_normal ? 2 : 6);
+
+		//Color
+		float e0[4], e1[4];
+		if (quality == img::quality_fast)
+			img::block::bounds(px, 3, e0, e1);
+		else
+			img::block::principal_endpoints(px, 3, e0, e1);
+
+		bc7_separate best;
+		for (int c = 0; c < 3; ++c)
+		{
+			best.rgb[0][c] = round_channel(e0[c], 127);
+			best.rgb[1][c] = round_channel(e1[c], 127);
+		}
+
+		unsigned char color[img::block::max_texels], alpha[img::block::max_texels], candidate[img::block::max_texels];
+		float color_error = bc7_rgb_evaluate(px, best.rgb, color);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			if (!img::block::fit_endpoints(px, color, fractions, 3, e0, e1))
+				break;
+
+			int rgb[2][3];
+			for (int c = 0; c < 3; ++c)
+			{
+				rgb[0][c] = round_channel(e0[c], 127);
+				rgb[1][c] = round_channel(e1[c], 127);
+			}
+
+			float error = bc7_rgb_evaluate(px, rgb, candidate);
+			if (error >= color_error)
+				break;
+
+			memcpy(best.rgb, rgb, sizeof(rgb));
+			color_error = error;
+			memcpy(color, candidate, px.count);
+		}
+
+		//Alpha
+		float low[4], high[4];
+		img::block::bounds(px, 4, low, high);
+		best.alpha[0] = (int)low[3];
+		best.alpha[1] = (int)high[3];
+		float alpha_error = bc7_alpha_evaluate(px, best.alpha, alpha);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			if (!img::block::fit_endpoints(px, alpha, fractions, 4, e0, e1))
+				break;
+
+			int values[2] = { round_channel(e0[3], 255), round_channel(e1[3], 255) };
+			float error = bc7_alpha_evaluate(px, values, candidate);
+			if (error >= alpha_error)
+				break;
+
+			best.alpha[0] = values[0];
+			best.alpha[1] = values[1];
+			alpha_error = error;
+			memcpy(alpha, candidate, px.count);
+		}
+
+		//Try every single step around the endpoints
+		for (int pass = 0; quality == img::quality_best && pass < 4; ++pass)
+		{
+			bool improved = false;
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					for (int delta = -1; delta <= 1; delta += 2)
+					{
+						bc7_separate trial = best;
+						int & value = (c < 3) ? trial.rgb[endpoint][c] : trial.alpha[endpoint];
+						value += delta;
+						if (value < 0 || value > (c < 3 ? 127 : 255)) continue;
+
+						if (c < 3)
+						{
+							float error = bc7_rgb_evaluate(px, trial.rgb, candidate);
+							if (error >= color_error) continue;
+							color_error = error;
+							memcpy(color, candidate, px.count);
+						}
+						else
+						{
+							float error = bc7_alpha_evaluate(px, trial.alpha, candidate);
+							if (error >= alpha_error) continue;
+							alpha_error = error;
+							memcpy(alpha, candidate, px.count);
+						}
+
+						best = trial;
+						improved = true;
+					}
+				}
+			}
+
+			if (!improved) break;
+		}
+
+		//The first index of each set has an implicit 0 top bit
+		if (color[0] >= 2)
+		{
+			for (int c = 0; c < 3; ++c)
+				std::swap(best.rgb[0][c], best.rgb[1][c]);
+			for (unsigned i = 0; i < 16; ++i)
+				color[i] = (unsigned char)(3 - color[i]);
+		}
+
+		if (alpha[0] >= 2)
+		{
+			std::swap(best.alpha[0], best.alpha[1]);
+			for (unsigned i = 0; i < 16; ++i)
+				alpha[i] = (unsigned char)(3 - alpha[i]);
+		}
+
+		memset(out, 0, 16);
+		unsigned pos = 0;
+		img::block::put_bits(out, pos, 1 << 5, 6);
+		//No channel rotation
+		img::block::put_bits(out, pos, 0, 2);
+		for (int c = 0; c < 3; ++c)
+		{
+			img::block::put_bits(out, pos, best.rgb[0][c], 7);
+			img::block::put_bits(out, pos, best.rgb[1][c], 7);
+		}
+		img::block::put_bits(out, pos, best.alpha[0], 8);
+		img::block::put_bits(out, pos, best.alpha[1], 8);
+
+		img::block::put_bits(out, pos, color[0], 1);
+		for (unsigned i = 1; i < 16; ++i)
+			img::block::put_bits(out, pos, color[i], 2);
+		img::block::put_bits(out, pos, alpha[0], 1);
+		for (unsigned i = 1; i < 16; ++i)
+			img::block::put_bits(out, pos, alpha[i], 2);
+
+		return color_error + alpha_error;
+	}
+}
+
+namespace img
+{
+	namespace block
+	{
+		void encode_bc1(const texels & source, encode_quality quality, bool transparent, unsigned char * out)
+		{
+			texels px = source;
+			bool three_color = false;
+			unsigned opaque = 0;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				if (transparent && px.ch[3][i] < 128.0f)
+				{
+					px.weight[i] = 0.0f;
+					three_color = true;
+				}
+				else ++opaque;
+			}
+
+			//Fully transparent - c0 <= c1 and every index 3
+			if (opaque == 0)
+			{
+				memset(out, 0, 4);
+				memset(out + 4, 0xFF, 4);
+				return;
+			}
+
+			encode_color(px, quality, three_color, out);
+		}
+
+		void encode_bc3(const texels & px, encode_quality quality, unsigned char * out)
+		{
+			encode_alpha(px, quality, out);
+			encode_color(px, quality, false, out + 8);
+		}
+
+		void encode_bc7(const texels & px, encode_quality quality, unsigned char * out)
+		{
+			bool opaque = true;
+			for (unsigned i = 0; i < px.count && opaque; ++i)
+				opaque = (px.ch[3][i] >= 255.0f);
+
+			//Mode 6 (one RGBA line) suits opaque blocks, mode 5 (separate alpha) the rest
+			//Other presets try both and keep the better one
+			if (quality == quality_fast)
+			{
+				if (opaque) bc7_mode6(px, quality, out);
+				else bc7_mode5(px, quality, out);
+				return;
+			}
+
+			unsigned char mode5[16];
+			float error6 = bc7_mode6(px, quality, out);
+			float error5 = bc7_mode5(px, quality, mode5);
+			if (error5 < error6)
+				memcpy(out, mode5, 16);
+		}
+	}
+}
@@ -0,0 +1,354 @@
+#include "block_internal.hpp"
+#include "../util/parallel.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define BLOCK_SSE2 1
+#endif
+
+namespace
+{
+	//Block rows per band when splitting work between threads
+	const size_t min_band_rows = 2;
+
+	inline float clamp_channel(float value)
+	{
+		return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+	}
+}
+
+namespace img
+{
+	bool parse_quality(const std::string & name, encode_quality & quality)
+	{
+		if (name == "fast") quality = quality_fast;
+		else if (name == "normal") quality = quality_normal;
+		else if (name == "best") quality = quality_best;
+		else return false;
+
+		return true;
+	}
+
+	bool parse_alpha_layout(const std::string & name, alpha_layout & layout)
+	{
+		if (name == "none") layout = alpha_none;
+		else if (name == "separate") layout = alpha_separate;
+		else if (name == "bottom") layout = alpha_bottom;
+		else return false;
+
+		return true;
+	}
+
+	std::vector<unsigned char> encode_blocks(const img & image, pixel_format format, encode_quality quality, bool alpha_as_gray)
+	{
+		unsigned block_w, block_h, block_bytes;
+		format_block(format, block_w, block_h, block_bytes);
+
+		unsigned blocks_x = (image.w() + block_w - 1) / block_w;
+		unsigned blocks_y = (image.h() + block_h - 1) / block_h;
+		std::vector<unsigned char> result((size_t)blocks_x * blocks_y * block_bytes);
+		if (result.empty() || !is_compressed(format)) return result;
+
+		unsigned char * out = result.data();
+		util::parallel_bands(blocks_y, min_band_rows, [&](size_t begin, size_t end)
+		{
+			block::texels px;
+			for (size_t by = begin; by < end; ++by)
+			{
+				for (unsigned bx = 0; bx < blocks_x; ++bx)
+				{
+					block::gather(image, bx * block_w, (unsigned)by * block_h, block_w, block_h, px);
+					if (alpha_as_gray) block::alpha_to_gray(px);
+					unsigned char * dst = out + (by * blocks_x + bx) * block_bytes;
+
+					switch (format)
+					{
+					case bc1: block::encode_bc1(px, quality, true, dst); break;
+					case bc3: block::encode_bc3(px, quality, dst); break;
+					case bc7: block::encode_bc7(px, quality, dst); break;
+					case etc1: block::encode_etc1(px, quality, dst); break;
+					case etc2_rgba: block::encode_etc2_rgba(px, quality, dst); break;
+					case astc_4x4:
+					case astc_6x6:
+					case astc_8x8: block::encode_astc(px, block_w, block_h, quality, dst); break;
+					default: break;
+					}
+				}
+			}
+		});
+
+		return result;
+	}
+
+	unsigned layout_height(unsigned h, pixel_format format, alpha_layout layout)
+	{
+		if (format != etc1 || layout != alpha_bottom) return h;
+
+		unsigned block_w, block_h, block_bytes;
+		format_block(format, block_w, block_h, block_bytes);
+		return (h + block_h - 1) / block_h * block_h * 2;
+	}
+
+	std::vector<unsigned char> encode_layout(const img & image, pixel_format format, encode_quality quality, alpha_layout layout)
+	{
+		auto result = encode_blocks(image, format, quality);
+		if (format == etc1 && layout == alpha_bottom)
+		{
+			auto alpha = encode_blocks(image, format, quality, true);
+			result.insert(result.end(), alpha.begin(), alpha.end());
+		}
+
+		return result;
+	}
+
+	namespace block
+	{
+		void gather(const img & image, unsigned x, unsigned y, unsigned width, unsigned height, texels & px)
+		{
+			px.count = width * height;
+			for (unsigned ty = 0; ty < height; ++ty)
+			{
+				for (unsigned tx = 0; tx < width; ++tx)
+				{
+					unsigned sx = std::min(x + tx, image.w() - 1);
+					unsigned sy = std::min(y + ty, image.h() - 1);
+					color c = image.get(sx, sy);
+
+					unsigned i = ty * width + tx;
+					px.ch[0][i] = c.r;
+					px.ch[1][i] = c.g;
+					px.ch[2][i] = c.b;
+					px.ch[3][i] = c.a;
+					px.weight[i] = 1.0f;
+				}
+			}
+		}
+
+		void alpha_to_gray(texels & px)
+		{
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				px.ch[0][i] = px.ch[1][i] = px.ch[2][i] = px.ch[3][i];
+				px.ch[3][i] = 255.0f;
+			}
+		}
+
+		float nearest(const texels & px, const float (*palette)[4], unsigned entries, const float channel_weights[4], unsigned char * indices)
+		{
+#ifdef BLOCK_SSE2
+			//4 texels at a time against every palette entry
+			__m128 total = _mm_setzero_ps();
+			__m128 weights[4];
+			for (int c = 0; c < 4; ++c)
+				weights[c] = _mm_set1_ps(channel_weights[c]);
+
+			for (unsigned i = 0; i < px.count; i += 4)
+			{
+				__m128 x[4];
+				for (int c = 0; c < 4; ++c)
+					x[c] = _mm_loadu_ps(&px.ch[c][i]);
+
+				__m128 best = _mm_set1_ps(FLT_MAX);
+				__m128i best_index = _mm_setzero_si128();
+				for (unsigned k = 0; k < entries; ++k)
+				{
+					__m128 dist = _mm_setzero_ps();
+					for (int c = 0; c < 4; ++c)
+					{
+						__m128 diff = _mm_sub_ps(x[c], _mm_set1_ps(palette[k][c]));
+						dist = _mm_add_ps(dist, _mm_mul_ps(_mm_mul_ps(diff, diff), weights[c]));
+					}
+
+					__m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+					best = _mm_min_ps(dist, best);
+					best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)k)), _mm_andnot_si128(closer, best_index));
+				}
+
+				total = _mm_add_ps(total, _mm_mul_ps(best, _mm_loadu_ps(&px.weight[i])));
+
+				int32_t index[4];
+				_mm_storeu_si128((__m128i *)index, best_index);
+				for (int j = 0; j < 4; ++j)
+					indices[i + j] = (unsigned char)index[j];
+			}
+
+			float sums[4];
+			_mm_storeu_ps(sums, total);
+			return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+			float total = 0.0f;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				float best = FLT_MAX;
+				for (unsigned k = 0; k < entries; ++k)
+				{
+					float dist = 0.0f;
+					for (int c = 0; c < 4; ++c)
+					{
+						float diff = px.ch[c][i] - palette[k][c];
+						dist += diff * diff * channel_weights[c];
+					}
+
+					if (dist < best)
+					{
+						best = dist;
+						indices[i] = (unsigned char)k;
+					}
+				}
+
+				total += best * px.weight[i];
+			}
+
+			return total;
+#endif
+		}
+
+		void bounds(const texels & px, unsigned channels, float low[4], float high[4])
+		{
+			for (unsigned c = 0; c < 4; ++c)
+			{
+				low[c] = 255.0f;
+				high[c] = 0.0f;
+			}
+
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				if (px.weight[i] <= 0.0f) continue;
+				for (unsigned c = 0; c < channels; ++c)
+				{
+					low[c] = std::min(low[c], px.ch[c][i]);
+					high[c] = std::max(high[c], px.ch[c][i]);
+				}
+			}
+
+			//No weighted texels
+			for (unsigned c = 0; c < 4; ++c)
+				if (low[c] > high[c]) low[c] = high[c] = 0.0f;
+		}
+
+		void principal_endpoints(const texels & px, unsigned channels, float e0[4], float e1[4])
+		{
+			float mean[4] = { 0, 0, 0, 0 };
+			float total = 0.0f;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				for (unsigned c = 0; c < channels; ++c)
+					mean[c] += px.ch[c][i] * px.weight[i];
+				total += px.weight[i];
+			}
+
+			if (total <= 0.0f)
+			{
+				bounds(px, channels, e0, e1);
+				return;
+			}
+
+			for (unsigned c = 0; c < channels; ++c)
+				mean[c] /= total;
+
+			//Covariance matrix
+			float cov[4][4] = { };
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				float d[4] = { 0, 0, 0, 0 };
+				for (unsigned c = 0; c < channels; ++c)
+					d[c] = px.ch[c][i] - mean[c];
+
+				for (unsigned a = 0; a < channels; ++a)
+					for (unsigned b = 0; b < channels; ++b)
+						cov[a][b] += d[a] * d[b] * px.weight[i];
+			}
+
+			//Power iteration, starting from the widest channel
+			float axis[4] = { 0, 0, 0, 0 };
+			unsigned widest = 0;
+			for (unsigned c = 1; c < channels; ++c)
+				if (cov[c][c] > cov[widest][widest]) widest = c;
+			axis[widest] = 1.0f;
+
+			for (int iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[4] = { 0, 0, 0, 0 };
+				float length = 0.0f;
+				for (unsigned a = 0; a < channels; ++a)
+				{
+					for (unsigned b = 0; b < channels; ++b)
+						next[a] += cov[a][b] * axis[b];
+					length += next[a] * next[a];
+				}
+
+				if (length <= 1e-12f) break;
+				length = 1.0f / sqrtf(length);
+				for (unsigned c = 0; c < channels; ++c)
+					axis[c] = next[c] * length;
+			}
+
+			float low = FLT_MAX, high = -FLT_MAX;
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				if (px.weight[i] <= 0.0f) continue;
+
+				float t = 0.0f;
+				for (unsigned c = 0; c < channels; ++c)
+					t += (px.ch[c][i] - mean[c]) * axis[c];
+
+				low = std::min(low, t);
+				high = std::max(high, t);
+			}
+
+			for (unsigned c = 0; c < 4; ++c)
+			{
+				e0[c] = (c < channels) ? clamp_channel(mean[c] + axis[c] * low) : 0.0f;
+				e1[c] = (c < channels) ? clamp_channel(mean[c] + axis[c] * high) : 0.0f;
+			}
+		}
+
+		bool fit_endpoints(const texels & px, const unsigned char * indices, const float * fractions, unsigned channels, float e0[4], float e1[4])
+		{
+			//Normal equations of sum |(1 - f) e0 + f e1 - x|^2
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[4] = { 0, 0, 0, 0 }, bx[4] = { 0, 0, 0, 0 };
+			for (unsigned i = 0; i < px.count; ++i)
+			{
+				float w = px.weight[i];
+				if (w <= 0.0f) continue;
+
+				float f = fractions[indices[i]];
+				float g = 1.0f - f;
+				aa += g * g * w;
+				ab += g * f * w;
+				bb += f * f * w;
+				for (unsigned c = 0; c < channels; ++c)
+				{
+					ax[c] += g * px.ch[c][i] * w;
+					bx[c] += f * px.ch[c][i] * w;
+				}
+			}
+
+			float det = aa * bb - ab * ab;
+			if (fabsf(det) < 1e-6f) return false;
+
+			det = 1.0f / det;
+			for (unsigned c = 0; c < channels; ++c)
+			{
+				e0[c] = clamp_channel((ax[c] * bb - bx[c] * ab) * det);
+				e1[c] = clamp_channel((bx[c] * aa - ax[c] * ab) * det);
+			}
+
+			return true;
+		}
+
+		void put_bits(unsigned char * out, unsigned & pos, unsigned value, unsigned bits)
+		{
+			for (unsigned i = 0; i < bits; ++i, ++pos)
+			{
+				if (value & (1u << i))
+					out[pos / 8] |= (unsigned char)(1u << (pos % 8));
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "img.hpp"
+#include "pixel_format.hpp"
+
+#include <string>
+#include <vector>
+
+namespace img
+{
+	//Speed/quality trade-off of block encoders
+	enum encode_quality
+	{
+		//Endpoints straight from the block bounds, for iteration builds
+		quality_fast,
+		//Principal axis endpoints with least squares refinement
+		quality_normal,
+		//More refinement and an exhaustive search around the endpoints
+		quality_best,
+	};
+
+	//Where ETC1 textures, which have no alpha, keep it
+	enum alpha_layout
+	{
+		//Alpha is dropped
+		alpha_none,
+		//A second texture with alpha as gray ("<texture>@alpha", as Cocos2D looks it up)
+		alpha_separate,
+		//The texture is twice as high, with alpha as gray in the bottom half
+		alpha_bottom,
+	};
+
+	//Find a quality preset by its name ("fast", "normal", "best"), false if unknown
+	bool parse_quality(const std::string & name, encode_quality & quality);
+	//Find an alpha layout by its name ("none", "separate", "bottom"), false if unknown
+	bool parse_alpha_layout(const std::string & name, alpha_layout & layout);
+
+	//Encode an image into a block compressed format, blocks are encoded in parallel
+	//Edge blocks of sizes that aren't a multiple of the footprint repeat the edge pixels
+	//With alpha_as_gray the alpha channel is encoded as an opaque gray image instead
+	std::vector<unsigned char> encode_blocks(const img & image, pixel_format format, encode_quality quality, bool alpha_as_gray = false);
+
+	//Height of a texture stored with an alpha layout (alpha_bottom stacks two block aligned images)
+	//Layouts only apply to ETC1, other formats keep their alpha
+	unsigned layout_height(unsigned h, pixel_format format, alpha_layout layout);
+	//Encode the blocks of the main texture of an alpha layout (with alpha_bottom, the alpha blocks follow the color)
+	std::vector<unsigned char> encode_layout(const img & image, pixel_format format, encode_quality quality, alpha_layout layout);
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "block.hpp"
+
+namespace img
+{
+	namespace block
+	{
+		//Most texels in a block (8x8 footprint)
+		const unsigned max_texels = 64;
+
+		//Block texels as floats, one array per channel (SIMD friendly)
+		struct texels
+		{
+			//RGBA channels (0..255)
+			float ch[4][max_texels];
+			//How much each texel counts in the error (0 for texels that don't matter)
+			float weight[max_texels];
+			//Number of texels (a multiple of 4)
+			unsigned count;
+		};
+
+		//Read a block of the image, repeating the edge pixels past the borders
+		void gather(const img & image, unsigned x, unsigned y, unsigned width, unsigned height, texels & px);
+		//Turn the alpha of a block into opaque gray
+		void alpha_to_gray(texels & px);
+
+		//Index of the nearest palette entry of every texel
+		//Returns the weighted squared error of the whole block
+		float nearest(const texels & px, const float (*palette)[4], unsigned entries, const float channel_weights[4], unsigned char * indices);
+
+		//Per channel minimum and maximum of the weighted texels
+		void bounds(const texels & px, unsigned channels, float low[4], float high[4]);
+		//Endpoints at the extremes of the texels along their principal axis
+		void principal_endpoints(const texels & px, unsigned channels, float e0[4], float e1[4]);
+		//Least squares endpoints for the given indices, fractions[index] is how far each index is from e0 towards e1
+		//False if the indices don't determine the endpoints
+		bool fit_endpoints(const texels & px, const unsigned char * indices, const float * fractions, unsigned channels, float e0[4], float e1[4]);
+
+		//Write an unsigned value into a little endian bit stream (the output starts zeroed)
+		void put_bits(unsigned char * out, unsigned & pos, unsigned value, unsigned bits);
+
+		//BC1 block (8 bytes), 1-bit alpha when transparent is set
+		void encode_bc1(const texels & px, encode_quality quality, bool transparent, unsigned char * out);
+		//BC3 block (16 bytes)
+		void encode_bc3(const texels & px, encode_quality quality, unsigned char * out);
+		//BC7 block (16 bytes)
+		void encode_bc7(const texels & px, encode_quality quality, unsigned char * out);
+		//ETC1 block (8 bytes), also a valid ETC2 RGB block
+		void encode_etc1(const texels & px, encode_quality quality, unsigned char * out);
+		//ETC2 RGBA8 block (16 bytes, EAC alpha and ETC2 color)
+		void encode_etc2_rgba(const texels & px, encode_quality quality, unsigned char * out);
+		//ASTC LDR block (16 bytes) of a width x height footprint (4x4, 6x6 or 8x8)
+		void encode_astc(const texels & px, unsigned width, unsigned height, encode_quality quality, unsigned char * out);
+	}
+}
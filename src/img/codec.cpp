@@ -0,0 +1,43 @@
+#include "codec.hpp"
+#include "png.hpp"
+#include "jpeg.hpp"
+#include "qoi.hpp"
+
+#include <vector>
+
+namespace
+{
+	template<class T>
+	img::img * create()
+	{
+		return new T();
+	}
+
+	//Built in codecs first, created on first use so registering from static constructors is safe
+	std::vector<img::codec> & codecs()
+	{
+		static std::vector<img::codec> registry = {
+			{ "PNG", &img::png::sniff, &create<img::png> },
+			{ "JPEG", &img::jpeg::sniff, &create<img::jpeg> },
+			{ "QOI", &img::qoi::sniff, &create<img::qoi> },
+		};
+		return registry;
+	}
+}
+
+namespace img
+{
+	void register_codec(const codec & format)
+	{
+		codecs().push_back(format);
+	}
+
+	const codec * find_codec(const unsigned char * data, size_t size)
+	{
+		for (auto & format : codecs())
+			if (format.sniff(data, size))
+				return &format;
+
+		return nullptr;
+	}
+}
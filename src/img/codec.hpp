@@ -0,0 +1,55 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "img.hpp"
+
+#include <cstddef>
+
+namespace img
+{
+	//Bytes of a file's start that codecs are told apart by
+	const size_t sniff_size = 16;
+
+	//Decoder of an image file format, picked by the first bytes of a file (see img::loadimg)
+	struct codec
+	{
+		//Format name, eg. "PNG"
+		const char * name;
+		//Does a file start like this format (up to sniff_size bytes, fewer if the file is shorter)
+		bool (*sniff)(const unsigned char * data, size_t size);
+		//Create an empty image of the format to load into
+		img * (*create)();
+	};
+
+	//Add a codec, checked after the ones added before it (PNG, JPEG and QOI are built in)
+	//Not thread safe - add codecs before images are loaded
+	void register_codec(const codec & format);
+	//Codec of a file from its first bytes, nullptr if none matches
+	const codec * find_codec(const unsigned char * data, size_t size);
+
+	//Adds a codec when constructed, so a codec can register itself from its own file:
+	//	static img::codec_registration webp({ "WebP", &webp::sniff, []() -> img::img * { return new webp(); } });
+	struct codec_registration
+	{
+		codec_registration(const codec & format) { register_codec(format); }
+	};
+}
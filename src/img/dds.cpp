@@ -0,0 +1,148 @@
+#include "dds.hpp"
+#include "png.hpp"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	struct dds_pixel_format
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourcc;
+		uint32_t rgb_bits;
+		uint32_t masks[4];
+	};
+
+	struct dds_header
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t linear_size;
+		uint32_t depth;
+		uint32_t mipmaps;
+		uint32_t reserved1[11];
+		dds_pixel_format format;
+		uint32_t caps[4];
+		uint32_t reserved2;
+	};
+
+	struct dds_header_dx10
+	{
+		uint32_t dxgi_format;
+		uint32_t dimension;
+		uint32_t misc_flags;
+		uint32_t array_size;
+		uint32_t misc_flags2;
+	};
+
+	static_assert(sizeof(dds_header) == 124, "DDS header must be 124 bytes");
+	static_assert(sizeof(dds_header_dx10) == 20, "DDS DX10 header must be 20 bytes");
+
+	const uint32_t ddsd_caps = 0x1;
+	const uint32_t ddsd_height = 0x2;
+	const uint32_t ddsd_width = 0x4;
+	const uint32_t ddsd_pixelformat = 0x1000;
+	const uint32_t ddsd_mipmapcount = 0x20000;
+	const uint32_t ddsd_linearsize = 0x80000;
+	const uint32_t ddpf_fourcc = 0x4;
+	const uint32_t ddscaps_complex = 0x8;
+	const uint32_t ddscaps_texture = 0x1000;
+	const uint32_t ddscaps_mipmap = 0x400000;
+	const uint32_t dxgi_format_bc7_unorm = 98;
+	const uint32_t d3d10_texture2d = 3;
+
+	uint32_t fourcc(const char * code)
+	{
+		return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+	}
+
+	//Write a DDS file with all the mip levels (largest first)
+	void write_dds(core::fwriter & fp, unsigned w, unsigned h, img::pixel_format format, std::vector<std::vector<unsigned char>> & levels)
+	{
+		dds_header header;
+		memset(&header, 0, sizeof(header));
+		header.size = sizeof(header);
+		header.flags = ddsd_caps | ddsd_height | ddsd_width | ddsd_pixelformat | ddsd_linearsize;
+		header.height = h;
+		header.width = w;
+		header.linear_size = (uint32_t)levels[0].size();
+		header.mipmaps = (uint32_t)levels.size();
+		header.format.size = sizeof(header.format);
+		header.format.flags = ddpf_fourcc;
+		header.caps[0] = ddscaps_texture;
+		if (levels.size() > 1)
+		{
+			header.flags |= ddsd_mipmapcount;
+			header.caps[0] |= ddscaps_complex | ddscaps_mipmap;
+		}
+
+		switch (format)
+		{
+		case img::bc1: header.format.fourcc = fourcc("DXT1"); break;
+		case img::bc3: header.format.fourcc = fourcc("DXT5"); break;
+		default: header.format.fourcc = fourcc("DX10"); break;
+		}
+
+		fp.write(fourcc("DDS "));
+		fp.write(header);
+
+		if (header.format.fourcc == fourcc("DX10"))
+		{
+			dds_header_dx10 dx10;
+			memset(&dx10, 0, sizeof(dx10));
+			dx10.dxgi_format = dxgi_format_bc7_unorm;
+			dx10.dimension = d3d10_texture2d;
+			dx10.array_size = 1;
+			fp.write(dx10);
+		}
+
+		for (auto & level : levels)
+			fp.write(level.data(), 1, level.size());
+	}
+}
+
+namespace img
+{
+	dds::dds(unsigned w, unsigned h, pixel_format format, encode_quality quality)
+		: img(w, h)
+		, _format(format)
+		, _quality(quality)
+	{ }
+
+	dds::dds() : img(), _format(bc1), _quality(quality_normal) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void dds::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+		if (_format != bc1 && _format != bc3 && _format != bc7)
+			throw std::exception("dds supports BC1, BC3 and BC7 only");
+
+		std::vector<std::vector<unsigned char>> levels;
+		levels.push_back(encode_blocks(*this, _format, _quality));
+		for (auto mip : _mips)
+			levels.push_back(encode_blocks(*mip, _format, _quality));
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		write_dds(fp, _w, _h, _format, levels);
+		fp.close();
+	}
+
+	void dds::load(const std::string &)
+	{
+		throw std::exception("dds loading isn't supported");
+	}
+
+	void dds::load(core::freader &)
+	{
+		throw std::exception("dds loading isn't supported");
+	}
+}
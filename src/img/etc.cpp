@@ -0,0 +1,386 @@
+#include "block_internal.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	using img::block::texels;
+
+	const float rgb_weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	const float alpha_weights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	//ETC1 intensity modifiers (small, large) - indices pick +small, +large, -small, -large
+	const int etc1_modifiers[8][2] = {
+		{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+		{ 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+	};
+
+	//EAC alpha modifiers
+	const int eac_modifiers[16][8] = {
+		{ -3, -6, -9, -15, 2, 5, 8, 14 },
+		{ -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 },
+		{ -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 },
+		{ -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 },
+		{ -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },
+		{ -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },
+		{ -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },
+		{ -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },
+		{ -3, -5, -7, -9, 2, 4, 6, 8 },
+	};
+
+	//EAC table with a zero modifier (index 4), for constant alpha
+	const int eac_constant_table = 13;
+
+	inline int clamp255(int value)
+	{
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	int round_channel(float value, int max)
+	{
+		int result = (int)floorf(value * max / 255.0f + 0.5f);
+		return result < 0 ? 0 : (result > max ? max : result);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//ETC1
+
+	//A half of the block (2x4 or 4x2 texels)
+	struct subblock
+	{
+		texels px;
+		//Block texel of every subblock texel
+		unsigned char source[8];
+	};
+
+	void split(const texels & px, bool flip, subblock sub[2])
+	{
+		unsigned count[2] = { 0, 0 };
+		for (unsigned y = 0; y < 4; ++y)
+		{
+			for (unsigned x = 0; x < 4; ++x)
+			{
+				unsigned half = flip ? (y >= 2) : (x >= 2);
+				unsigned i = y * 4 + x;
+				unsigned j = count[half]++;
+
+				for (int c = 0; c < 4; ++c)
+					sub[half].px.ch[c][j] = px.ch[c][i];
+				sub[half].px.weight[j] = px.weight[i];
+				sub[half].source[j] = (unsigned char)i;
+			}
+		}
+
+		sub[0].px.count = sub[1].px.count = 8;
+	}
+
+	//Best modifier table for a subblock with an (expanded) base color
+	float etc1_table(const subblock & sub, const int base[3], int & table, unsigned char * indices)
+	{
+		float best = FLT_MAX;
+		unsigned char candidate[8];
+		for (int t = 0; t < 8; ++t)
+		{
+			const int modifiers[4] = { etc1_modifiers[t][0], etc1_modifiers[t][1], -etc1_modifiers[t][0], -etc1_modifiers[t][1] };
+			float palette[4][4];
+			for (int k = 0; k < 4; ++k)
+			{
+				for (int c = 0; c < 3; ++c)
+					palette[k][c] = (float)clamp255(base[c] + modifiers[k]);
+				palette[k][3] = 255.0f;
+			}
+
+			float error = img::block::nearest(sub.px, palette, 4, rgb_weights, candidate);
+			if (error < best)
+			{
+				best = error;
+				table = t;
+				memcpy(indices, candidate, 8);
+			}
+		}
+
+		return best;
+	}
+
+	//Average color of the weighted texels of a subblock
+	void average(const subblock & sub, float avg[3])
+	{
+		float total = 0.0f;
+		for (int c = 0; c < 3; ++c)
+			avg[c] = 0.0f;
+
+		for (unsigned i = 0; i < 8; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				avg[c] += sub.px.ch[c][i] * sub.px.weight[i];
+			total += sub.px.weight[i];
+		}
+
+		//Nothing visible - any color will do
+		if (total <= 0.0f)
+		{
+			for (int c = 0; c < 3; ++c)
+				avg[c] = 0.0f;
+			return;
+		}
+
+		for (int c = 0; c < 3; ++c)
+			avg[c] /= total;
+	}
+
+	//An ETC1 block candidate
+	struct etc1_block
+	{
+		bool flip;
+		bool differential;
+		//Quantized base colors (4 bits individual, 5 bits differential)
+		int base[2][3];
+		int table[2];
+		//Index of every block texel
+		unsigned char indices[16];
+		float error;
+	};
+
+	//Tables and indices for the base colors of a candidate
+	void etc1_evaluate(const subblock sub[2], etc1_block & blk)
+	{
+		blk.error = 0.0f;
+		for (int half = 0; half < 2; ++half)
+		{
+			int color[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				int v = blk.base[half][c];
+				color[c] = blk.differential ? ((v << 3) | (v >> 2)) : ((v << 4) | v);
+			}
+
+			unsigned char indices[8];
+			blk.error += etc1_table(sub[half], color, blk.table[half], indices);
+			for (unsigned j = 0; j < 8; ++j)
+				blk.indices[sub[half].source[j]] = indices[j];
+		}
+	}
+
+	//Can the second base color be stored as a 3-bit delta from the first one
+	bool etc1_reachable(const int first[3], const int second[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			int delta = second[c] - first[c];
+			if (delta < -4 || delta > 3) return false;
+		}
+
+		return true;
+	}
+
+	//Base colors from the subblock averages, false if differential mode had to pull them together
+	bool etc1_bases(const float avg[2][3], etc1_block & blk)
+	{
+		int max = blk.differential ? 31 : 15;
+		for (int half = 0; half < 2; ++half)
+			for (int c = 0; c < 3; ++c)
+				blk.base[half][c] = round_channel(avg[half][c], max);
+
+		if (!blk.differential || etc1_reachable(blk.base[0], blk.base[1]))
+			return true;
+
+		for (int c = 0; c < 3; ++c)
+			blk.base[1][c] = std::min(std::max(blk.base[1][c], blk.base[0][c] - 4), blk.base[0][c] + 3);
+		return false;
+	}
+
+	//Try every base color one step away, one half at a time
+	void etc1_refine(const subblock sub[2], etc1_block & blk)
+	{
+		int max = blk.differential ? 31 : 15;
+		for (int half = 0; half < 2; ++half)
+		{
+			int start[3] = { blk.base[half][0], blk.base[half][1], blk.base[half][2] };
+			etc1_block trial = blk;
+			for (int step = 0; step < 27; ++step)
+			{
+				const int delta[3] = { step % 3 - 1, step / 3 % 3 - 1, step / 9 - 1 };
+				bool valid = true;
+				for (int c = 0; c < 3; ++c)
+				{
+					trial.base[half][c] = start[c] + delta[c];
+					valid = valid && trial.base[half][c] >= 0 && trial.base[half][c] <= max;
+				}
+
+				if (!valid || (blk.differential && !etc1_reachable(trial.base[0], trial.base[1])))
+					continue;
+
+				etc1_evaluate(sub, trial);
+				if (trial.error < blk.error)
+					blk = trial;
+			}
+		}
+	}
+
+	void etc1_pack(const etc1_block & blk, unsigned char * out)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			if (blk.differential)
+				out[c] = (unsigned char)((blk.base[0][c] << 3) | ((blk.base[1][c] - blk.base[0][c]) & 7));
+			else
+				out[c] = (unsigned char)((blk.base[0][c] << 4) | blk.base[1][c]);
+		}
+
+		out[3] = (unsigned char)((blk.table[0] << 5) | (blk.table[1] << 2) | (blk.differential ? 2 : 0) | (blk.flip ? 1 : 0));
+
+		//Texels go column by column, index msbs in the high half, lsbs in the low half
+		uint32_t bits = 0;
+		for (unsigned y = 0; y < 4; ++y)
+		{
+			for (unsigned x = 0; x < 4; ++x)
+			{
+				unsigned p = x * 4 + y;
+				unsigned index = blk.indices[y * 4 + x];
+				bits |= ((index >> 1) & 1u) << (16 + p);
+				bits |= (index & 1u) << p;
+			}
+		}
+
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = (unsigned char)(bits >> (24 - 8 * i));
+	}
+
+	void encode_color(const texels & px, img::encode_quality quality, unsigned char * out)
+	{
+		etc1_block best;
+		best.error = FLT_MAX;
+
+		subblock sub[2];
+		for (int flip = 0; flip < 2; ++flip)
+		{
+			split(px, flip != 0, sub);
+			float avg[2][3];
+			average(sub[0], avg[0]);
+			average(sub[1], avg[1]);
+
+			//Differential mode first, individual mode only helps when the halves differ a lot
+			for (int mode = 1; mode >= 0; --mode)
+			{
+				etc1_block blk;
+				blk.flip = (flip != 0);
+				blk.differential = (mode == 1);
+				bool exact = etc1_bases(avg, blk);
+
+				etc1_evaluate(sub, blk);
+				if (quality == img::quality_best)
+					etc1_refine(sub, blk);
+				if (blk.error < best.error)
+					best = blk;
+
+				if (quality == img::quality_fast && blk.differential && exact)
+					break;
+			}
+		}
+
+		etc1_pack(best, out);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	//EAC alpha
+
+	float eac_evaluate(const texels & px, int base, int multiplier, int table, unsigned char * indices)
+	{
+		float palette[8][4] = { };
+		for (int k = 0; k < 8; ++k)
+			palette[k][3] = (float)clamp255(base + eac_modifiers[table][k] * multiplier);
+
+		return img::block::nearest(px, palette, 8, alpha_weights, indices);
+	}
+
+	void encode_alpha(const texels & px, img::encode_quality quality, unsigned char * out)
+	{
+		float low[4], high[4];
+		img::block::bounds(px, 4, low, high);
+		int lo = (int)low[3], hi = (int)high[3];
+
+		int best_base = lo, best_multiplier = 1, best_table = eac_constant_table;
+		unsigned char indices[16], candidate[16];
+		memset(indices, 4, sizeof(indices));
+
+		//Constant alpha is exact with a zero modifier (multiplier 0 is reserved)
+		if (lo != hi)
+		{
+			float best = FLT_MAX;
+			int multiplier_range = (quality == img::quality_fast) ? 0 : 1;
+			int base_range = (quality == img::quality_best) ? 2 : 0;
+
+			for (int table = 0; table < 16; ++table)
+			{
+				//Stretch the table over the alpha range
+				int table_lo = eac_modifiers[table][3], table_hi = eac_modifiers[table][7];
+				int fit = (int)floorf((hi - lo) / (float)(table_hi - table_lo) + 0.5f);
+
+				for (int m = fit - multiplier_range; m <= fit + multiplier_range; ++m)
+				{
+					int multiplier = std::min(std::max(m, 1), 15);
+					int center = (int)floorf((lo + hi) * 0.5f - (table_lo + table_hi) * multiplier * 0.5f + 0.5f);
+
+					for (int b = center - base_range; b <= center + base_range; ++b)
+					{
+						int base = clamp255(b);
+						float error = eac_evaluate(px, base, multiplier, table, candidate);
+						if (error < best)
+						{
+							best = error;
+							best_base = base;
+							best_multiplier = multiplier;
+							best_table = table;
+							memcpy(indices, candidate, sizeof(indices));
+						}
+					}
+				}
+			}
+		}
+
+		out[0] = (unsigned char)best_base;
+		out[1] = (unsigned char)((best_multiplier << 4) | best_table);
+
+		//48 bits of 3-bit indices, column by column, first texel in the top bits
+		uint64_t bits = 0;
+		for (unsigned y = 0; y < 4; ++y)
+			for (unsigned x = 0; x < 4; ++x)
+				bits |= (uint64_t)indices[y * 4 + x] << (45 - 3 * (x * 4 + y));
+
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (unsigned char)(bits >> (40 - 8 * i));
+	}
+}
+
+namespace img
+{
+	namespace block
+	{
+		void encode_etc1(const texels & px, encode_quality quality, unsigned char * out)
+		{
+			encode_color(px, quality, out);
+		}
+
+		void encode_etc2_rgba(const texels & source, encode_quality quality, unsigned char * out)
+		{
+			encode_alpha(source, quality, out);
+
+			//The color of transparent texels doesn't matter
+			texels px = source;
+			for (unsigned i = 0; i < px.count; ++i)
+				if (px.ch[3][i] <= 0.0f) px.weight[i] = 0.0f;
+
+			encode_color(px, quality, out + 8);
+		}
+	}
+}
@@ -1,6 +1,9 @@
 #include "img.hpp"
 #include "png.hpp"
-#include "jpeg.hpp"
+#include "codec.hpp"
+
+#include <algorithm>
+#include <string.h>
 
 namespace img
 {
@@ -18,6 +21,15 @@ namespace img
 	{
 		if (_data != nullptr)
 			delete[] _data;
+		for (auto level : _mips)
+			delete level;
+	}
+
+	void img::mipmaps(const std::vector<png *> & levels)
+	{
+		for (auto level : _mips)
+			delete level;
+		_mips = levels;
 	}
 
 	color img::get(unsigned x, unsigned y) const
@@ -38,79 +50,151 @@ namespace img
 		_data[y*_w + x] = c;
 	}
 
+	void img::blit(const img & src, unsigned x, unsigned y)
+	{
+		if (_data == nullptr || src._data == nullptr) return;
+		if (x >= _w || y >= _h) return;
+
+		//Whole rows at once
+		unsigned w = std::min(src._w, _w - x);
+		unsigned h = std::min(src._h, _h - y);
+		for (unsigned yy = 0; yy < h; ++yy)
+			memcpy(&_data[(size_t)(y + yy) * _w + x], &src._data[(size_t)yy * src._w], w * sizeof(color));
+	}
+
+	void img::blit_rotated(const img & src, unsigned x, unsigned y)
+	{
+		if (_data == nullptr || src._data == nullptr) return;
+		if (x >= _w) return;
+
+		//Source column xx is destination row y - xx, written left to right
+		unsigned w = std::min(src._h, _w - x);
+		unsigned first = (y >= _h) ? y - _h + 1 : 0;
+		unsigned h = (y < src._w) ? y + 1 : src._w;
+		for (unsigned xx = first; xx < h; ++xx)
+		{
+			color * dst = &_data[(size_t)(y - xx) * _w + x];
+			const color * col = &src._data[xx];
+			for (unsigned yy = 0; yy < w; ++yy)
+				dst[yy] = col[(size_t)yy * src._w];
+		}
+	}
+
+	void img::blit_channel(const img & src, unsigned x, unsigned y, unsigned channel, bool rotated)
+	{
+		if (_data == nullptr || src._data == nullptr) return;
+		if (x >= _w || channel > 3) return;
+
+		//Same clipping as blit and blit_rotated, the other channels are left alone
+		if (!rotated)
+		{
+			if (y >= _h) return;
+			unsigned w = std::min(src._w, _w - x);
+			unsigned h = std::min(src._h, _h - y);
+			for (unsigned yy = 0; yy < h; ++yy)
+			{
+				byte * dst = (byte *)&_data[(size_t)(y + yy) * _w + x] + channel;
+				const color * row = &src._data[(size_t)yy * src._w];
+				for (unsigned xx = 0; xx < w; ++xx)
+					dst[xx * 4] = row[xx].r;
+			}
+			return;
+		}
+
+		unsigned w = std::min(src._h, _w - x);
+		unsigned first = (y >= _h) ? y - _h + 1 : 0;
+		unsigned h = (y < src._w) ? y + 1 : src._w;
+		for (unsigned xx = first; xx < h; ++xx)
+		{
+			byte * dst = (byte *)&_data[(size_t)(y - xx) * _w + x] + channel;
+			const color * col = &src._data[xx];
+			for (unsigned yy = 0; yy < w; ++yy)
+				dst[yy * 4] = col[(size_t)yy * src._w].r;
+		}
+	}
+
 	png * img::load_extended(const std::string & fname)
 	{
 		auto normal = loadimg(fname);
 		if (normal == nullptr) return nullptr;
-		png * result = new png(normal->w() + 2, normal->h() + 2);
+		png * result = extended(*normal);
+		delete normal;
+		return result;
+	}
+
+	png * img::extended(const img & normal)
+	{
+		png * result = new png(normal.w() + 2, normal.h() + 2);
 		
-		if (normal->w() > 0 && normal->h() > 0)
+		if (normal.w() > 0 && normal.h() > 0)
 		{
-			for (unsigned x = 0; x < normal->w(); ++x)
-				for (unsigned y = 0; y < normal->h(); ++y)
-					result->set(x + 1, y + 1, normal->get(x, y));
+			for (unsigned x = 0; x < normal.w(); ++x)
+				for (unsigned y = 0; y < normal.h(); ++y)
+					result->set(x + 1, y + 1, normal.get(x, y));
 
-			for (unsigned x = 0; x < normal->w(); ++x)
+			for (unsigned x = 0; x < normal.w(); ++x)
 			{
-				result->set(x + 1, 0, normal->get(x, 1));
-				result->set(x + 1, result->h() - 1, normal->get(x, normal->h() - 1));
+				result->set(x + 1, 0, normal.get(x, 1));
+				result->set(x + 1, result->h() - 1, normal.get(x, normal.h() - 1));
 			}
 
-			for (unsigned y = 0; y < normal->h(); ++y)
+			for (unsigned y = 0; y < normal.h(); ++y)
 			{
-				result->set(0, y + 1, normal->get(1, y));
-				result->set(result->w() - 1, y + 1, normal->get(normal->w() - 1, y));
+				result->set(0, y + 1, normal.get(1, y));
+				result->set(result->w() - 1, y + 1, normal.get(normal.w() - 1, y));
 			}
 		}
 
 		return result;
 	}
 
-	img * img::loadimg(const std::string & fname)
+	png * img::extend(const img & image, unsigned w, unsigned h)
 	{
-		img * res = nullptr;
+		png * result = new png(w, h);
+		if (image.w() == 0 || image.h() == 0) return result;
 
-		//Try as PNG
-		res = new png();
-		try {
-			res->load(fname);
-			return (res);
-		} catch (...)
-		{ delete res; }
+		for (unsigned y = 0; y < h; ++y)
+		{
+			unsigned sy = std::min(y, image.h() - 1);
+			for (unsigned x = 0; x < w; ++x)
+				result->set(x, y, image.get(std::min(x, image.w() - 1), sy));
+		}
 
-		//Try as JPEG
-		res = new jpeg();
-		try {
-			res->load(fname);
-			return (res);
-		} catch (...)
-		{ delete res; }
+		return result;
+	}
 
-		//None of the types above
-		return (nullptr);
+	img * img::loadimg(const std::string & fname)
+	{
+		//One open handle, the codec is picked from its first bytes
+		auto fp = core::io::read(fname, true);
+		if (!fp.opened() || !fp.ok())
+			return (nullptr);
+
+		img * res = loadimg(fp);
+		fp.close();
+		return (res);
 	}
 
 	img * img::loadimg(core::freader & reader)
 	{
-		img * res = nullptr;
-
-		//Try as PNG
-		res = new png();
-		try {
-			res->load(reader);
-			return (res);
-		} catch (...)
-		{ delete res; }
-
-		//Try as JPEG
-		res = new jpeg();
+		unsigned char head[sniff_size];
+		long start = reader.pos();
+		size_t size = reader.read(head, 1, sizeof(head));
+		reader.seek(start, core::io::start);
+
+		//None of the registered formats
+		const codec * format = find_codec(head, size);
+		if (format == nullptr)
+			return (nullptr);
+
+		//Only a broken file throws now
+		img * res = format->create();
 		try {
 			res->load(reader);
 			return (res);
 		} catch (...)
 		{ delete res; }
 
-		//None of the types above
 		return (nullptr);
 	}
 }
@@ -26,6 +26,7 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 #include "color.hpp"
 
 #include <string>
+#include <vector>
 
 namespace img
 {
@@ -37,6 +38,8 @@ namespace img
 		color * _data;
 		unsigned _w;
 		unsigned _h;
+		//Smaller mip levels, level 1 first (owned)
+		std::vector<png *> _mips;
 
 	public:
 		using byte = unsigned char;
@@ -61,6 +64,17 @@ namespace img
 		color get(unsigned x, unsigned y) const;
 		//Set color to specific pixel
 		void set(unsigned x, unsigned y, const color & c);
+		//Copy an image in, its top left corner at x, y (clipped)
+		void blit(const img & src, unsigned x, unsigned y);
+		//Copy an image in rotated, its rows becoming columns that go up from x, y (clipped)
+		void blit_rotated(const img & src, unsigned x, unsigned y);
+		//Copy the red channel of an image into one channel (0-3 = R, G, B, A), rotated like blit_rotated if asked
+		void blit_channel(const img & src, unsigned x, unsigned y, unsigned channel, bool rotated = false);
+		//Mip levels, level 1 first
+		inline const std::vector<png *> & mipmaps() const { return _mips; }
+		//Set the mip levels written after the image by formats that store them (the image takes ownership)
+		void mipmaps(const std::vector<png *> & levels);
+
 		//Fill a rect with specific color
 		inline void fill(util::rect rect, const color & col) //TODO - see why this is here
 		{
@@ -85,6 +99,10 @@ namespace img
 
 		//Load image with extensions
 		static png * load_extended(const std::string & fname);
+		//Copy an image with extensions
+		static png * extended(const img & normal);
+		//Grow an image to w x h, repeating its last column and row into the new space
+		static png * extend(const img & image, unsigned w, unsigned h);
 
 		//Load iamge
 		static img * loadimg(const std::string & fname);
@@ -245,6 +245,11 @@ namespace img
 		, quality(100)
 	{ }
 
+	bool jpeg::sniff(const unsigned char * data, size_t size)
+	{
+		return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+	}
+
 	////////////////////////////////////////////////////////////
 
 	void jpeg::save(const std::string & fname)
@@ -255,6 +260,8 @@ namespace img
 
 		auto outfile = core::io::write(fname.c_str(), true, false);
 		if (!outfile.opened() || !outfile.ok()) throw std::exception("cant open file");
+		//encode while the previous chunk is being written
+		outfile.async(true);
 
 		struct jpeg_compress_struct info;
 		struct core_error_mgr jerr;
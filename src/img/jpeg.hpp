@@ -37,5 +37,8 @@ namespace img
 		void save(const std::string & fname) override;
 		void load(const std::string & fname) override;
 		void load(core::freader & reader) override;
+
+		//Does data start like a JPEG file (SOI and the next marker, at least 3 bytes)
+		static bool sniff(const unsigned char * data, size_t size);
 	};
 }
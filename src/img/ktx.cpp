@@ -0,0 +1,231 @@
+#include "ktx.hpp"
+#include "png.hpp"
+#include "../util/parallel.hpp"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	struct ktx_header
+	{
+		uint8_t identifier[12];
+		uint32_t endianness;
+		uint32_t gl_type;
+		uint32_t gl_type_size;
+		uint32_t gl_format;
+		uint32_t gl_internal_format;
+		uint32_t gl_base_internal_format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t array_elements;
+		uint32_t faces;
+		uint32_t mipmaps;
+		uint32_t key_value_size;
+	};
+
+	static_assert(sizeof(ktx_header) == 64, "KTX header must be 64 bytes");
+
+	//"«KTX 11»\r\n\x1A\n"
+	const uint8_t ktx_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	const uint32_t ktx_endianness = 0x04030201;
+
+	//OpenGL enums
+	const uint32_t gl_unsigned_byte = 0x1401;
+	const uint32_t gl_unsigned_short_4_4_4_4 = 0x8033;
+	const uint32_t gl_unsigned_short_5_5_5_1 = 0x8034;
+	const uint32_t gl_unsigned_short_5_6_5 = 0x8363;
+	const uint32_t gl_alpha = 0x1906;
+	const uint32_t gl_luminance = 0x1909;
+	const uint32_t gl_luminance_alpha = 0x190A;
+	const uint32_t gl_rgb = 0x1907;
+	const uint32_t gl_rgba = 0x1908;
+	const uint32_t gl_alpha8 = 0x803C;
+	const uint32_t gl_luminance8 = 0x8040;
+	const uint32_t gl_luminance8_alpha8 = 0x8045;
+	const uint32_t gl_rgb8 = 0x8051;
+	const uint32_t gl_rgba4 = 0x8056;
+	const uint32_t gl_rgb5_a1 = 0x8057;
+	const uint32_t gl_rgba8 = 0x8058;
+	const uint32_t gl_rgb565 = 0x8D62;
+	const uint32_t gl_etc1_rgb8 = 0x8D64;
+	const uint32_t gl_compressed_rgba8_etc2_eac = 0x9278;
+	const uint32_t gl_compressed_rgb_s3tc_dxt1 = 0x83F1;
+	const uint32_t gl_compressed_rgba_s3tc_dxt5 = 0x83F3;
+	const uint32_t gl_compressed_rgba_bptc_unorm = 0x8E8C;
+	const uint32_t gl_compressed_rgba_astc_4x4 = 0x93B0;
+	const uint32_t gl_compressed_rgba_astc_6x6 = 0x93B4;
+	const uint32_t gl_compressed_rgba_astc_8x8 = 0x93B7;
+
+	//Rows and mip levels are 4 byte aligned
+	inline size_t align4(size_t size)
+	{
+		return (size + 3) & ~(size_t)3;
+	}
+
+	void ktx_format(img::pixel_format format, ktx_header & header)
+	{
+		header.gl_type = 0;
+		header.gl_type_size = 1;
+		header.gl_format = 0;
+		header.gl_base_internal_format = gl_rgba;
+
+		switch (format)
+		{
+		case img::rgba4444:
+			header.gl_type = gl_unsigned_short_4_4_4_4;
+			header.gl_type_size = 2;
+			header.gl_format = gl_rgba;
+			header.gl_internal_format = gl_rgba4;
+			break;
+		case img::rgb565:
+			header.gl_type = gl_unsigned_short_5_6_5;
+			header.gl_type_size = 2;
+			header.gl_format = header.gl_base_internal_format = gl_rgb;
+			header.gl_internal_format = gl_rgb565;
+			break;
+		case img::rgba5551:
+			header.gl_type = gl_unsigned_short_5_5_5_1;
+			header.gl_type_size = 2;
+			header.gl_format = gl_rgba;
+			header.gl_internal_format = gl_rgb5_a1;
+			break;
+		case img::rgb888:
+			header.gl_type = gl_unsigned_byte;
+			header.gl_format = header.gl_base_internal_format = gl_rgb;
+			header.gl_internal_format = gl_rgb8;
+			break;
+		case img::a8:
+			header.gl_type = gl_unsigned_byte;
+			header.gl_format = header.gl_base_internal_format = gl_alpha;
+			header.gl_internal_format = gl_alpha8;
+			break;
+		case img::l8:
+			header.gl_type = gl_unsigned_byte;
+			header.gl_format = header.gl_base_internal_format = gl_luminance;
+			header.gl_internal_format = gl_luminance8;
+			break;
+		case img::la88:
+			header.gl_type = gl_unsigned_byte;
+			header.gl_format = header.gl_base_internal_format = gl_luminance_alpha;
+			header.gl_internal_format = gl_luminance8_alpha8;
+			break;
+		case img::bc1: header.gl_internal_format = gl_compressed_rgb_s3tc_dxt1; header.gl_base_internal_format = gl_rgb; break;
+		case img::bc3: header.gl_internal_format = gl_compressed_rgba_s3tc_dxt5; break;
+		case img::bc7: header.gl_internal_format = gl_compressed_rgba_bptc_unorm; break;
+		case img::etc1: header.gl_internal_format = gl_etc1_rgb8; header.gl_base_internal_format = gl_rgb; break;
+		case img::etc2_rgba: header.gl_internal_format = gl_compressed_rgba8_etc2_eac; break;
+		case img::astc_4x4: header.gl_internal_format = gl_compressed_rgba_astc_4x4; break;
+		case img::astc_6x6: header.gl_internal_format = gl_compressed_rgba_astc_6x6; break;
+		case img::astc_8x8: header.gl_internal_format = gl_compressed_rgba_astc_8x8; break;
+		default:
+			header.gl_type = gl_unsigned_byte;
+			header.gl_format = gl_rgba;
+			header.gl_internal_format = gl_rgba8;
+			break;
+		}
+	}
+
+	//Pack an image with 4 byte aligned rows
+	std::vector<unsigned char> pack_rows(const img::img & image, img::pixel_format format)
+	{
+		size_t row_size = (size_t)image.w() * img::format_size(format);
+		size_t stride = align4(row_size);
+		std::vector<unsigned char> result(stride * image.h(), 0);
+
+		unsigned char * dst = result.data();
+		const img::color * src = (const img::color *)image.data();
+		unsigned w = image.w();
+		util::parallel_bands(image.h(), 64, [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y)
+				img::pack(src + y * w, w, format, dst + y * stride);
+		});
+
+		return result;
+	}
+
+	//Write a KTX file with all the mip levels (largest first)
+	void write_ktx(core::fwriter & fp, unsigned w, unsigned h, img::pixel_format format, std::vector<std::vector<unsigned char>> & levels)
+	{
+		ktx_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+		header.endianness = ktx_endianness;
+		ktx_format(format, header);
+		header.width = w;
+		header.height = h;
+		header.faces = 1;
+		header.mipmaps = (uint32_t)levels.size();
+
+		fp.write(header);
+
+		unsigned char padding[4] = { 0, 0, 0, 0 };
+		for (auto & level : levels)
+		{
+			fp.write((uint32_t)level.size());
+			fp.write(level.data(), 1, level.size());
+			if (align4(level.size()) != level.size())
+				fp.write(padding, 1, align4(level.size()) - level.size());
+		}
+	}
+}
+
+namespace img
+{
+	ktx::ktx(unsigned w, unsigned h, pixel_format format, encode_quality quality, alpha_layout alpha)
+		: img(w, h)
+		, _format(format)
+		, _quality(quality)
+		, _alpha(alpha)
+	{ }
+
+	ktx::ktx() : img(), _format(rgba8888), _quality(quality_normal), _alpha(alpha_none) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void ktx::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+
+		std::vector<const img *> images(1, this);
+		images.insert(images.end(), _mips.begin(), _mips.end());
+
+		std::vector<std::vector<unsigned char>> levels;
+		for (auto image : images)
+		{
+			if (is_compressed(_format))
+				levels.push_back(encode_layout(*image, _format, _quality, _alpha));
+			else
+				levels.push_back(pack_rows(*image, _format));
+		}
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		write_ktx(fp, _w, layout_height(_h, _format, _alpha), _format, levels);
+		fp.close();
+
+		if (_format != etc1 || _alpha != alpha_separate)
+			return;
+
+		for (size_t i = 0; i < images.size(); ++i)
+			levels[i] = encode_blocks(*images[i], _format, _quality, true);
+		auto alpha_fp = core::io::write(fname + "@alpha", true, false);
+		if (!alpha_fp.opened() || !alpha_fp.ok()) throw std::exception("cant open for writing");
+
+		write_ktx(alpha_fp, _w, _h, _format, levels);
+		alpha_fp.close();
+	}
+
+	void ktx::load(const std::string &)
+	{
+		throw std::exception("ktx loading isn't supported");
+	}
+
+	void ktx::load(core::freader &)
+	{
+		throw std::exception("ktx loading isn't supported");
+	}
+}
@@ -0,0 +1,52 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "img.hpp"
+#include "block.hpp"
+
+namespace img
+{
+	//KTX (v1) texture, raw or block compressed (ETC1, ETC2, BC1/BC3/BC7, ASTC)
+	//ETC1 alpha is kept according to the alpha layout - alpha_separate writes "<fname>@alpha" too
+	//Encoded on save - only writing is supported
+	class ktx : public img
+	{
+		//pixel format
+		pixel_format _format;
+		//encoder preset
+		encode_quality _quality;
+		//where ETC1 keeps alpha
+		alpha_layout _alpha;
+
+	public:
+		ktx();
+		ktx(unsigned w, unsigned h, pixel_format format = rgba8888, encode_quality quality = quality_normal, alpha_layout alpha = alpha_none);
+
+		//Pixel format
+		inline pixel_format format() const { return _format; }
+		//ETC1 alpha layout
+		inline alpha_layout alpha() const { return _alpha; }
+
+		void save(const std::string & fname) override;
+		void load(const std::string & fname) override;
+		void load(core::freader & reader) override;
+	};
+}
@@ -0,0 +1,193 @@
+#include "mipmap.hpp"
+#include "png.hpp"
+#include "../util/parallel.hpp"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define MIPMAP_SSE2 1
+#endif
+
+namespace
+{
+	//Rows per band when splitting work between threads
+	const size_t min_band_rows = 16;
+	//Owner of texels outside every region
+	const int no_region = -1;
+	//Entries of the linear to sRGB table
+	const unsigned encode_size = 4096;
+
+	//sRGB <-> linear light conversion tables
+	struct srgb_tables
+	{
+		float decode[256];
+		unsigned char encode[encode_size];
+
+		srgb_tables()
+		{
+			for (unsigned i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				decode[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (unsigned i = 0; i < encode_size; ++i)
+			{
+				float c = i / (float)(encode_size - 1);
+				float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+				encode[i] = (unsigned char)(s * 255.0f + 0.5f);
+			}
+		}
+
+		inline unsigned char to_srgb(float linear) const
+		{
+			if (linear <= 0.0f) return 0;
+			if (linear >= 1.0f) return 255;
+			return encode[(unsigned)(linear * (encode_size - 1) + 0.5f)];
+		}
+	};
+
+	const srgb_tables & srgb()
+	{
+		static const srgb_tables tables;
+		return tables;
+	}
+
+	inline unsigned char to_byte(float value)
+	{
+		return (unsigned char)(value <= 0.0f ? 0 : (value >= 1.0f ? 255 : (int)(value * 255.0f + 0.5f)));
+	}
+
+	//Sum of texels in linear light
+	//Keeps (rgb * a, a) so transparent texels don't darken edges, and plain (rgb, 1) for fully transparent areas
+	class box
+	{
+#ifdef MIPMAP_SSE2
+		__m128 _weighted;
+		__m128 _plain;
+#else
+		float _weighted[4];
+		float _plain[4];
+#endif
+
+	public:
+		box()
+		{
+#ifdef MIPMAP_SSE2
+			_weighted = _plain = _mm_setzero_ps();
+#else
+			for (int ch = 0; ch < 4; ++ch)
+				_weighted[ch] = _plain[ch] = 0.0f;
+#endif
+		}
+
+		inline void add(const img::color & c, const srgb_tables & tables)
+		{
+			float a = c.a / 255.0f;
+#ifdef MIPMAP_SSE2
+			__m128 linear = _mm_setr_ps(tables.decode[c.r], tables.decode[c.g], tables.decode[c.b], 1.0f);
+			_weighted = _mm_add_ps(_weighted, _mm_mul_ps(linear, _mm_set1_ps(a)));
+			_plain = _mm_add_ps(_plain, linear);
+#else
+			float linear[4] = { tables.decode[c.r], tables.decode[c.g], tables.decode[c.b], 1.0f };
+			for (int ch = 0; ch < 4; ++ch)
+			{
+				_weighted[ch] += linear[ch] * a;
+				_plain[ch] += linear[ch];
+			}
+#endif
+		}
+
+		//Average of the texels added
+		img::color average(const srgb_tables & tables) const
+		{
+			float weighted[4], plain[4];
+#ifdef MIPMAP_SSE2
+			_mm_storeu_ps(weighted, _weighted);
+			_mm_storeu_ps(plain, _plain);
+#else
+			for (int ch = 0; ch < 4; ++ch)
+			{
+				weighted[ch] = _weighted[ch];
+				plain[ch] = _plain[ch];
+			}
+#endif
+			if (plain[3] == 0.0f) return img::color(0, 0, 0, 0);
+
+			const float * sum = (weighted[3] > 0.0f) ? weighted : plain;
+			float scale = 1.0f / sum[3];
+			return img::color(
+				tables.to_srgb(sum[0] * scale),
+				tables.to_srgb(sum[1] * scale),
+				tables.to_srgb(sum[2] * scale),
+				to_byte(weighted[3] / plain[3]));
+		}
+	};
+}
+
+namespace img
+{
+	std::vector<png *> build_mipmaps(const img & image, const std::vector<util::rect> & regions)
+	{
+		std::vector<png *> result;
+		unsigned sw = image.w(), sh = image.h();
+		if (sw == 0 || sh == 0) return result;
+
+		const srgb_tables & tables = srgb();
+
+		//Region of every base texel (later regions win where they overlap)
+		std::vector<int> owner((size_t)sw * sh, no_region);
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			const util::rect & r = regions[i];
+			unsigned x0 = (unsigned)std::max(r.x, 0), y0 = (unsigned)std::max(r.y, 0);
+			unsigned x1 = std::min((unsigned)std::max(r.x + r.w, 0), sw);
+			unsigned y1 = std::min((unsigned)std::max(r.y + r.h, 0), sh);
+			for (unsigned y = y0; y < y1; ++y)
+				for (unsigned x = x0; x < x1; ++x)
+					owner[(size_t)y * sw + x] = (int)i;
+		}
+
+		const img * src = &image;
+		while (sw > 1 || sh > 1)
+		{
+			unsigned w = std::max(sw / 2, 1u), h = std::max(sh / 2, 1u);
+			png * dst = new png(w, h);
+			std::vector<int> next_owner((size_t)w * h);
+
+			const color * pixels = (const color *)src->data();
+			color * out = (color *)dst->data();
+			util::parallel_bands(h, min_band_rows, [&](size_t begin, size_t end) {
+				for (size_t y = begin; y < end; ++y)
+				{
+					//Odd sizes fold the last row and column into the last texel
+					unsigned y0 = (unsigned)y * 2, y1 = (y + 1 == h) ? sh : y0 + 2;
+					for (unsigned x = 0; x < w; ++x)
+					{
+						unsigned x0 = x * 2, x1 = (x + 1 == w) ? sw : x0 + 2;
+
+						//The texel belongs to the region of its top left source texel
+						int region = owner[(size_t)y0 * sw + x0];
+						box sum;
+						for (unsigned yy = y0; yy < y1; ++yy)
+							for (unsigned xx = x0; xx < x1; ++xx)
+								if (owner[(size_t)yy * sw + xx] == region)
+									sum.add(pixels[(size_t)yy * sw + xx], tables);
+
+						out[y * w + x] = sum.average(tables);
+						next_owner[y * w + x] = region;
+					}
+				}
+			});
+
+			result.push_back(dst);
+			owner.swap(next_owner);
+			src = dst;
+			sw = w;
+			sh = h;
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,569 @@
+#include "palette.hpp"
+#include "../util/parallel.hpp"
+
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define PALETTE_SSE2 1
+#endif
+
+namespace
+{
+	//Rows per band when mapping pixels on several threads
+	const size_t min_band_rows = 32;
+	//Starting size of the histogram table (power of 2)
+	const unsigned initial_bits = 10;
+	//Slots of every thread's table of recently mapped colors (power of 2)
+	const unsigned cache_bits = 12;
+	//Difference between the lowest and highest ordered dithering threshold, in 8-bit steps
+	const int ordered_spread = 16;
+	//Alpha counts double when matching colors, so edges keep their shape
+	const int16_t alpha_weight = 2;
+
+	//4x4 Bayer matrix (0..15)
+	const int bayer[4][4] = {
+		{  0,  8,  2, 10 },
+		{ 12,  4, 14,  6 },
+		{  3, 11,  1,  9 },
+		{ 15,  7, 13,  5 },
+	};
+
+	inline uint32_t code_of(const img::color & c)
+	{
+		uint32_t code;
+		memcpy(&code, &c, sizeof(code));
+		return code;
+	}
+
+	inline uint32_t hash(uint32_t code, unsigned shift)
+	{
+		return (uint32_t)(code * 2654435761u) >> shift;
+	}
+
+	inline img::color::byte clamp(int value)
+	{
+		return (img::color::byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+	}
+
+	//A color and the number of pixels with it
+	struct entry
+	{
+		img::color color;
+		uint32_t count;
+	};
+
+	//Range of entries that becomes one palette color
+	struct box
+	{
+		size_t begin;
+		size_t end;
+		uint64_t pixels;
+		//Channel with the widest range of values, and the range
+		int channel;
+		int range;
+	};
+
+	void measure(box & b, const std::vector<entry> & entries)
+	{
+		int lo[4] = { 255, 255, 255, 255 }, hi[4] = { 0, 0, 0, 0 };
+		b.pixels = 0;
+		for (size_t i = b.begin; i < b.end; ++i)
+		{
+			const img::color::byte * c = &entries[i].color.r;
+			for (int ch = 0; ch < 4; ++ch)
+			{
+				lo[ch] = std::min(lo[ch], (int)c[ch]);
+				hi[ch] = std::max(hi[ch], (int)c[ch]);
+			}
+			b.pixels += entries[i].count;
+		}
+
+		b.channel = 0;
+		for (int ch = 1; ch < 4; ++ch)
+			if (hi[ch] - lo[ch] > hi[b.channel] - lo[b.channel])
+				b.channel = ch;
+		b.range = hi[b.channel] - lo[b.channel];
+	}
+
+	//Mean color of a box, weighted by pixels
+	img::color average(const box & b, const std::vector<entry> & entries)
+	{
+		uint64_t sum[4] = { 0, 0, 0, 0 };
+		for (size_t i = b.begin; i < b.end; ++i)
+		{
+			const img::color::byte * c = &entries[i].color.r;
+			for (int ch = 0; ch < 4; ++ch)
+				sum[ch] += (uint64_t)c[ch] * entries[i].count;
+		}
+
+		img::color::byte result[4];
+		for (int ch = 0; ch < 4; ++ch)
+			result[ch] = (img::color::byte)((sum[ch] + b.pixels / 2) / b.pixels);
+		return img::color(result[0], result[1], result[2], result[3]);
+	}
+
+	//Split the colors into boxes at the pixel median of their widest channel (a k-d tree),
+	//the box with most pixels times range first, and average every box
+	std::vector<img::color> median_cut(std::vector<entry> & entries, unsigned max_colors)
+	{
+		std::vector<img::color> result;
+		if (entries.empty() || max_colors == 0)
+			return result;
+
+		std::vector<box> boxes(1);
+		boxes[0].begin = 0;
+		boxes[0].end = entries.size();
+		measure(boxes[0], entries);
+
+		while (boxes.size() < max_colors)
+		{
+			size_t widest = boxes.size();
+			uint64_t widest_score = 0;
+			for (size_t i = 0; i < boxes.size(); ++i)
+			{
+				uint64_t score = boxes[i].pixels * (uint64_t)boxes[i].range;
+				if (boxes[i].end - boxes[i].begin > 1 && score > widest_score)
+				{
+					widest = i;
+					widest_score = score;
+				}
+			}
+
+			//Every box is a single color
+			if (widest == boxes.size())
+				break;
+
+			box lower = boxes[widest];
+			int ch = lower.channel;
+			std::sort(entries.begin() + lower.begin, entries.begin() + lower.end, [ch](const entry & a, const entry & b) {
+				const img::color::byte * ca = &a.color.r, * cb = &b.color.r;
+				return (ca[ch] != cb[ch]) ? (ca[ch] < cb[ch]) : (code_of(a.color) < code_of(b.color));
+			});
+
+			//Both halves keep at least one color
+			uint64_t half = lower.pixels / 2, sum = 0;
+			size_t split = lower.begin;
+			while (split < lower.end - 1 && sum + entries[split].count <= half)
+				sum += entries[split++].count;
+			if (split == lower.begin) ++split;
+
+			box upper = lower;
+			upper.begin = split;
+			lower.end = split;
+			measure(lower, entries);
+			measure(upper, entries);
+			boxes[widest] = lower;
+			boxes.push_back(upper);
+		}
+
+		for (auto & b : boxes)
+			result.push_back(average(b, entries));
+		return result;
+	}
+
+	//Finds the nearest palette entry (squared RGBA distance, alpha weighted)
+	class matcher
+	{
+		//16-bit channels of the entries, padded to a multiple of 4 entries with copies of the last one
+		std::vector<int16_t> _channels;
+		size_t _count;
+		//Entry invisible pixels go to (-1 if none)
+		int _transparent;
+
+	public:
+		matcher(const std::vector<img::color> & colors)
+			: _count(colors.size())
+			, _transparent(-1)
+		{
+			size_t padded = (_count + 3) / 4 * 4;
+			_channels.resize(padded * 4);
+			for (size_t i = 0; i < padded; ++i)
+			{
+				const img::color::byte * c = &colors[std::min(i, _count - 1)].r;
+				for (int ch = 0; ch < 4; ++ch)
+					_channels[i * 4 + ch] = c[ch];
+				_channels[i * 4 + 3] *= alpha_weight;
+			}
+
+			for (size_t i = 0; i < _count && _transparent < 0; ++i)
+				if (colors[i].a == 0) _transparent = (int)i;
+		}
+
+		unsigned nearest(const img::color & c) const
+		{
+			if (c.a == 0 && _transparent >= 0)
+				return (unsigned)_transparent;
+
+			size_t padded = _channels.size() / 4;
+#ifdef PALETTE_SSE2
+			//4 entries at a time, 2 per register - madd sums the squares of channel pairs
+			const int16_t a = c.a * alpha_weight;
+			const __m128i query = _mm_setr_epi16(c.r, c.g, c.b, a, c.r, c.g, c.b, a);
+			const __m128i * src = (const __m128i *)_channels.data();
+			__m128i best = _mm_set1_epi32(INT_MAX);
+			__m128i best_index = _mm_setzero_si128();
+			__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+			for (size_t i = 0; i < padded; i += 4, src += 2)
+			{
+				__m128i d01 = _mm_sub_epi16(_mm_loadu_si128(src), query);
+				__m128i d23 = _mm_sub_epi16(_mm_loadu_si128(src + 1), query);
+				__m128i m01 = _mm_madd_epi16(d01, d01);
+				__m128i m23 = _mm_madd_epi16(d23, d23);
+				m01 = _mm_add_epi32(m01, _mm_shuffle_epi32(m01, _MM_SHUFFLE(2, 3, 0, 1)));
+				m23 = _mm_add_epi32(m23, _mm_shuffle_epi32(m23, _MM_SHUFFLE(2, 3, 0, 1)));
+				__m128i dist = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(m01), _mm_castsi128_ps(m23), _MM_SHUFFLE(2, 0, 2, 0)));
+
+				__m128i closer = _mm_cmplt_epi32(dist, best);
+				best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+				best_index = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_index));
+				index = _mm_add_epi32(index, _mm_set1_epi32(4));
+			}
+
+			int dists[4], indices[4];
+			_mm_storeu_si128((__m128i *)dists, best);
+			_mm_storeu_si128((__m128i *)indices, best_index);
+			int result = 0;
+			for (int lane = 1; lane < 4; ++lane)
+				if (dists[lane] < dists[result] || (dists[lane] == dists[result] && indices[lane] < indices[result]))
+					result = lane;
+			return (unsigned)indices[result];
+#else
+			const int q[4] = { c.r, c.g, c.b, c.a * alpha_weight };
+			unsigned result = 0;
+			int best = INT_MAX;
+			for (size_t i = 0; i < _count; ++i)
+			{
+				int dist = 0;
+				for (int ch = 0; ch < 4; ++ch)
+				{
+					int d = _channels[i * 4 + ch] - q[ch];
+					dist += d * d;
+				}
+
+				if (dist < best)
+				{
+					best = dist;
+					result = (unsigned)i;
+				}
+			}
+			return result;
+#endif
+		}
+	};
+
+	//Recently mapped colors of one thread (direct mapped)
+	class cache
+	{
+		std::vector<uint32_t> _codes;
+		std::vector<int16_t> _entries;
+
+	public:
+		cache() : _codes((size_t)1 << cache_bits), _entries((size_t)1 << cache_bits, -1) { }
+
+		unsigned nearest(const matcher & match, const img::color & c)
+		{
+			uint32_t code = code_of(c);
+			uint32_t slot = hash(code, 32 - cache_bits);
+			if (_entries[slot] < 0 || _codes[slot] != code)
+			{
+				_codes[slot] = code;
+				_entries[slot] = (int16_t)match.nearest(c);
+			}
+
+			return (unsigned)_entries[slot];
+		}
+	};
+
+	void map_rows(const matcher & match, const img::color * pixels, unsigned char * indices, unsigned w, size_t begin, size_t end, bool ordered)
+	{
+		cache recent;
+		for (size_t y = begin; y < end; ++y)
+		{
+			const img::color * row = pixels + y * w;
+			unsigned char * dst = indices + y * w;
+			for (unsigned x = 0; x < w; ++x)
+			{
+				img::color c = row[x];
+				if (ordered)
+				{
+					int bias = ((2 * bayer[y % 4][x % 4] + 1) * ordered_spread) / 32 - ordered_spread / 2;
+					c.r = clamp(c.r + bias);
+					c.g = clamp(c.g + bias);
+					c.b = clamp(c.b + bias);
+					//Keep fully transparent and opaque pixels as they are
+					if (c.a != 0 && c.a != 255) c.a = clamp(c.a + bias);
+				}
+
+				dst[x] = (unsigned char)recent.nearest(match, c);
+			}
+		}
+	}
+
+	//Serpentine Floyd-Steinberg - every row depends on the one above, so this one stays serial
+	void floyd_steinberg(const matcher & match, const std::vector<img::color> & colors, const img::color * pixels, unsigned char * indices, unsigned w, unsigned h)
+	{
+		cache recent;
+		//Error carried into the current and the next row (1 pixel margin on both sides)
+		std::vector<int> current((w + 2) * 4, 0), next((w + 2) * 4, 0);
+
+		for (unsigned y = 0; y < h; ++y)
+		{
+			bool reverse = (y % 2) != 0;
+			int dir = reverse ? -1 : 1;
+			const img::color * row = pixels + (size_t)y * w;
+
+			for (unsigned i = 0; i < w; ++i)
+			{
+				unsigned x = reverse ? (w - 1 - i) : i;
+				const img::color::byte * src = &row[x].r;
+
+				//Invisible pixels take and pass on no error
+				if (row[x].a == 0)
+				{
+					indices[(size_t)y * w + x] = (unsigned char)recent.nearest(match, row[x]);
+					continue;
+				}
+
+				//Fully opaque and transparent alpha stays as it is, or edges would bleed into it
+				bool alpha = (src[3] != 255);
+				img::color::byte wanted[4];
+				for (int ch = 0; ch < 4; ++ch)
+				{
+					bool diffused = (ch < 3 || alpha);
+					wanted[ch] = diffused ? clamp(src[ch] + current[(x + 1) * 4 + ch] / 16) : src[ch];
+				}
+
+				unsigned index = recent.nearest(match, img::color(wanted[0], wanted[1], wanted[2], wanted[3]));
+				indices[(size_t)y * w + x] = (unsigned char)index;
+
+				const img::color::byte * result = &colors[index].r;
+				for (int ch = 0; ch < 4; ++ch)
+				{
+					if (ch == 3 && !alpha) continue;
+					int error = wanted[ch] - result[ch];
+					current[(x + 1 + dir) * 4 + ch] += error * 7;
+					next[(x + 1 - dir) * 4 + ch] += error * 3;
+					next[(x + 1) * 4 + ch] += error * 5;
+					next[(x + 1 + dir) * 4 + ch] += error;
+				}
+			}
+
+			current.swap(next);
+			std::fill(next.begin(), next.end(), 0);
+		}
+	}
+
+	//Translucent entries first, returns the new position of every entry
+	std::vector<unsigned char> translucent_first(std::vector<img::color> & colors)
+	{
+		std::vector<unsigned> order(colors.size());
+		for (unsigned i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(),
+			[&colors](unsigned a, unsigned b) { return (colors[a].a != 255) && (colors[b].a == 255); });
+
+		std::vector<img::color> sorted(colors.size());
+		std::vector<unsigned char> position(colors.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			sorted[i] = colors[order[i]];
+			position[order[i]] = (unsigned char)i;
+		}
+
+		colors.swap(sorted);
+		return position;
+	}
+}
+
+namespace img
+{
+	color_histogram::color_histogram(size_t limit)
+		: _codes((size_t)1 << initial_bits)
+		, _counts((size_t)1 << initial_bits, 0)
+		, _shift(32 - initial_bits)
+		, _size(0)
+		, _limit(limit)
+	{ }
+
+	uint32_t & color_histogram::insert(uint32_t code)
+	{
+		size_t mask = _codes.size() - 1;
+		size_t slot = hash(code, _shift);
+		while (_counts[slot] != 0 && _codes[slot] != code)
+			slot = (slot + 1) & mask;
+
+		if (_counts[slot] == 0)
+		{
+			//At most half full
+			if ((_size + 1) * 2 > _codes.size())
+			{
+				grow();
+				return insert(code);
+			}
+
+			_codes[slot] = code;
+			++_size;
+		}
+
+		return _counts[slot];
+	}
+
+	void color_histogram::grow()
+	{
+		std::vector<uint32_t> codes(_codes.size() * 2), counts(_codes.size() * 2, 0);
+		codes.swap(_codes);
+		counts.swap(_counts);
+		--_shift;
+
+		size_t mask = _codes.size() - 1;
+		for (size_t i = 0; i < codes.size(); ++i)
+		{
+			if (counts[i] == 0) continue;
+			size_t slot = hash(codes[i], _shift);
+			while (_counts[slot] != 0)
+				slot = (slot + 1) & mask;
+			_codes[slot] = codes[i];
+			_counts[slot] = counts[i];
+		}
+	}
+
+	bool color_histogram::add(const color * pixels, size_t count)
+	{
+		//Count of the previous pixel's color, so runs skip the table
+		uint32_t * last = nullptr;
+		uint32_t last_code = 0;
+		auto add_one = [&](const color & c)
+		{
+			uint32_t code = code_of(c);
+			if (last == nullptr || code != last_code)
+			{
+				last = &insert(code);
+				last_code = code;
+			}
+
+			++*last;
+			return (_limit == 0 || _size <= _limit);
+		};
+
+		size_t i = 0;
+#ifdef PALETTE_SSE2
+		//Runs of one color (empty space, flat fills) are counted 4 pixels at a time
+		for (; i + 4 <= count; i += 4)
+		{
+			if (last != nullptr)
+			{
+				__m128i quad = _mm_loadu_si128((const __m128i *)(pixels + i));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(quad, _mm_set1_epi32((int)last_code))) == 0xFFFF)
+				{
+					*last += 4;
+					continue;
+				}
+			}
+
+			for (size_t k = i; k < i + 4; ++k)
+				if (!add_one(pixels[k])) return false;
+		}
+#endif
+		for (; i < count; ++i)
+			if (!add_one(pixels[i])) return false;
+
+		return true;
+	}
+
+	void color_histogram::entries(std::vector<color> & colors, std::vector<uint32_t> & counts) const
+	{
+		colors.clear();
+		counts.clear();
+		for (size_t i = 0; i < _codes.size(); ++i)
+		{
+			if (_counts[i] == 0) continue;
+			//Codes are the bytes in memory order
+			const unsigned char * bytes = (const unsigned char *)&_codes[i];
+			colors.push_back(color(bytes[0], bytes[1], bytes[2], bytes[3]));
+			counts.push_back(_counts[i]);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+
+	palette make_palette(const img & image, unsigned max_colors, dither_mode dither)
+	{
+		max_colors = std::min(std::max(max_colors, 1u), 256u);
+		const color * pixels = (const color *)image.data();
+		unsigned w = image.w(), h = image.h();
+		size_t count = (size_t)w * h;
+
+		palette result;
+		result.indices.resize(count);
+
+		color_histogram histogram;
+		histogram.add(pixels, count);
+		result.exact = (histogram.size() <= max_colors);
+
+		//Few enough colors are all kept, numbered in order of appearance
+		if (result.exact)
+		{
+			std::vector<uint32_t> codes(4 * max_colors);
+			std::vector<int16_t> numbers(codes.size(), -1);
+			uint32_t shift = 32;
+			for (size_t n = codes.size(); n > 1; n >>= 1) --shift;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				uint32_t code = code_of(pixels[i]);
+				size_t slot = hash(code, shift);
+				while (numbers[slot] >= 0 && codes[slot] != code)
+					slot = (slot + 1) % codes.size();
+
+				if (numbers[slot] < 0)
+				{
+					codes[slot] = code;
+					numbers[slot] = (int16_t)result.colors.size();
+					result.colors.push_back(pixels[i]);
+				}
+
+				result.indices[i] = (unsigned char)numbers[slot];
+			}
+
+			auto position = translucent_first(result.colors);
+			for (auto & index : result.indices)
+				index = position[index];
+			return result;
+		}
+
+		//Invisible pixels all share one transparent entry and take no part in the cut
+		std::vector<color> colors;
+		std::vector<uint32_t> counts;
+		histogram.entries(colors, counts);
+
+		std::vector<entry> visible;
+		bool transparent = false;
+		for (size_t i = 0; i < colors.size(); ++i)
+		{
+			if (colors[i].a == 0) transparent = true;
+			else visible.push_back({ colors[i], counts[i] });
+		}
+
+		result.colors = median_cut(visible, max_colors - (transparent ? 1 : 0));
+		if (transparent) result.colors.insert(result.colors.begin(), color(0, 0, 0, 0));
+		translucent_first(result.colors);
+
+		const matcher match(result.colors);
+		unsigned char * indices = result.indices.data();
+		if (dither == dither_floyd_steinberg)
+		{
+			floyd_steinberg(match, result.colors, pixels, indices, w, h);
+		}
+		else
+		{
+			bool ordered = (dither == dither_ordered);
+			util::parallel_bands(h, min_band_rows,
+				[&](size_t begin, size_t end) { map_rows(match, pixels, indices, w, begin, end, ordered); });
+		}
+
+		return result;
+	}
+}
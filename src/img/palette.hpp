@@ -0,0 +1,72 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "img.hpp"
+#include "pixel_format.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace img
+{
+	//Distinct colors of pixels and how many pixels have each (open addressing hash table)
+	class color_histogram
+	{
+		//Color codes (bytes in memory order) and pixel counts, a count of 0 is an empty slot
+		std::vector<uint32_t> _codes;
+		std::vector<uint32_t> _counts;
+		//Hash is the top bits of code * golden ratio
+		unsigned _shift;
+		size_t _size;
+		size_t _limit;
+
+		//Count of a color, added if it's new (only valid until the next insert)
+		uint32_t & insert(uint32_t code);
+		void grow();
+
+	public:
+		//Stop adding colors past a limit (0 = no limit)
+		color_histogram(size_t limit = 0);
+
+		//Add pixels, false once there are more colors than the limit
+		bool add(const color * pixels, size_t count);
+		//Number of distinct colors (at most limit + 1)
+		inline size_t size() const { return _size; }
+		//Distinct colors and their pixel counts, in no particular order
+		void entries(std::vector<color> & colors, std::vector<uint32_t> & counts) const;
+	};
+
+	//Colors of an image reduced to a palette
+	struct palette
+	{
+		//Entries, translucent ones first so PNG transparency chunks stay short
+		std::vector<color> colors;
+		//Entry of every pixel
+		std::vector<unsigned char> indices;
+		//Every pixel kept its color
+		bool exact;
+	};
+
+	//Palettize an image to at most max_colors entries (256 at most)
+	//Exact if it has no more colors, otherwise reduced by median cut and mapped to the nearest entries
+	palette make_palette(const img & image, unsigned max_colors, dither_mode dither);
+}
@@ -0,0 +1,323 @@
+#include "pixel_format.hpp"
+
+#include <ctype.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define PIXEL_FORMAT_SSE2 1
+#endif
+
+namespace
+{
+	//Rec. 601 luma
+	inline unsigned char luma(const img::color & c)
+	{
+		return (unsigned char)((c.r * 77 + c.g * 150 + c.b * 29 + 128) >> 8);
+	}
+
+#ifdef PIXEL_FORMAT_SSE2
+	//Luma and alpha of 8 pixels, in 16-bit lanes
+	inline void luma_alpha(const img::color * src, __m128i & luma, __m128i & alpha)
+	{
+		const __m128i byte = _mm_set1_epi32(0xFF);
+		__m128i lo = _mm_loadu_si128((const __m128i *)src);
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + 4));
+		__m128i r = _mm_packs_epi32(_mm_and_si128(lo, byte), _mm_and_si128(hi, byte));
+		__m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), byte), _mm_and_si128(_mm_srli_epi32(hi, 8), byte));
+		__m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), byte), _mm_and_si128(_mm_srli_epi32(hi, 16), byte));
+		alpha = _mm_packs_epi32(_mm_srli_epi32(lo, 24), _mm_srli_epi32(hi, 24));
+
+		//At most 255 * 256 + 128, the sum doesn't wrap
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)), _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+		luma = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+#endif
+
+	//Nearest N-bit value of an 8-bit channel
+	inline unsigned narrow(unsigned value, unsigned bits)
+	{
+		unsigned max = (1u << bits) - 1;
+		return (value * max + 127) / 255;
+	}
+
+	//Widen an N-bit channel back to 8 bits
+	inline unsigned char expand(unsigned value, unsigned bits)
+	{
+		unsigned max = (1u << bits) - 1;
+		return (unsigned char)((value * 255 + max / 2) / max);
+	}
+}
+
+namespace img
+{
+	const char * format_name(pixel_format format)
+	{
+		switch (format)
+		{
+		case rgba4444: return "RGBA4444";
+		case rgb565: return "RGB565";
+		case rgba5551: return "RGBA5551";
+		case rgb888: return "RGB888";
+		case bc1: return "BC1";
+		case bc3: return "BC3";
+		case bc7: return "BC7";
+		case etc1: return "ETC1";
+		case etc2_rgba: return "ETC2_RGBA";
+		case astc_4x4: return "ASTC_4x4";
+		case astc_6x6: return "ASTC_6x6";
+		case astc_8x8: return "ASTC_8x8";
+		case a8: return "A8";
+		case l8: return "I8";
+		case la88: return "AI88";
+		default: return "RGBA8888";
+		}
+	}
+
+	bool parse_format(const std::string & name, pixel_format & format)
+	{
+		static const pixel_format formats[] = { rgba8888, rgba4444, rgb565, rgba5551, rgb888, bc1, bc3, bc7, etc1, etc2_rgba, astc_4x4, astc_6x6, astc_8x8, a8, l8, la88 };
+		if (name == "L8" || name == "l8")
+		{
+			format = l8;
+			return true;
+		}
+		if (name == "LA88" || name == "la88")
+		{
+			format = la88;
+			return true;
+		}
+
+		for (auto fmt : formats)
+		{
+			const char * fmt_name = format_name(fmt);
+			if (name.size() != strlen(fmt_name)) continue;
+
+			bool same = true;
+			for (size_t i = 0; i < name.size() && same; ++i)
+				same = (toupper((unsigned char)name[i]) == toupper((unsigned char)fmt_name[i]));
+
+			if (same)
+			{
+				format = fmt;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	unsigned format_size(pixel_format format)
+	{
+		switch (format)
+		{
+		case rgba8888: return 4;
+		case rgb888: return 3;
+		case a8: case l8: return 1;
+		default: return 2;
+		}
+	}
+
+	bool is_compressed(pixel_format format)
+	{
+		return (format == bc1 || format == bc3 || format == bc7 || format == etc1 || format == etc2_rgba || is_astc(format));
+	}
+
+	bool is_astc(pixel_format format)
+	{
+		return (format == astc_4x4 || format == astc_6x6 || format == astc_8x8);
+	}
+
+	void format_block(pixel_format format, unsigned & width, unsigned & height, unsigned & bytes)
+	{
+		if (format == astc_6x6) width = height = 6;
+		else if (format == astc_8x8) width = height = 8;
+		else width = height = is_compressed(format) ? 4 : 1;
+		if (format == bc1 || format == etc1) bytes = 8;
+		else bytes = is_compressed(format) ? 16 : format_size(format);
+	}
+
+	void format_bits(pixel_format format, unsigned bits[4])
+	{
+		static const unsigned table[][4] = {
+			{ 8, 8, 8, 8 },	//rgba8888
+			{ 4, 4, 4, 4 },	//rgba4444
+			{ 5, 6, 5, 0 },	//rgb565
+			{ 5, 5, 5, 1 },	//rgba5551
+			{ 8, 8, 8, 0 },	//rgb888
+		};
+
+		static const unsigned alpha_only[4] = { 0, 0, 0, 8 };
+		static const unsigned luminance[4] = { 8, 8, 8, 0 };
+		static const unsigned luminance_alpha[4] = { 8, 8, 8, 8 };
+
+		//Block compressed formats have no fixed precision
+		for (int i = 0; i < 4; ++i)
+		{
+			if (format == a8) bits[i] = alpha_only[i];
+			else if (format == l8) bits[i] = luminance[i];
+			else if (format == la88) bits[i] = luminance_alpha[i];
+			else bits[i] = is_compressed(format) ? 8 : table[format][i];
+		}
+	}
+
+	bool parse_dither(const std::string & name, dither_mode & dither)
+	{
+		if (name == "none") dither = dither_none;
+		else if (name == "ordered") dither = dither_ordered;
+		else if (name == "floyd-steinberg") dither = dither_floyd_steinberg;
+		else return false;
+
+		return true;
+	}
+
+	void pack(const color * src, size_t count, pixel_format format, unsigned char * dst)
+	{
+		switch (format)
+		{
+		case rgba8888:
+			memcpy(dst, src, count * sizeof(color));
+			break;
+
+		case rgba4444:
+			for (size_t i = 0; i < count; ++i)
+			{
+				const color & c = src[i];
+				unsigned value = (narrow(c.r, 4) << 12) | (narrow(c.g, 4) << 8) | (narrow(c.b, 4) << 4) | narrow(c.a, 4);
+				dst[i * 2 + 0] = (unsigned char)value;
+				dst[i * 2 + 1] = (unsigned char)(value >> 8);
+			}
+			break;
+
+		case rgb565:
+			for (size_t i = 0; i < count; ++i)
+			{
+				const color & c = src[i];
+				unsigned value = (narrow(c.r, 5) << 11) | (narrow(c.g, 6) << 5) | narrow(c.b, 5);
+				dst[i * 2 + 0] = (unsigned char)value;
+				dst[i * 2 + 1] = (unsigned char)(value >> 8);
+			}
+			break;
+
+		case rgba5551:
+			for (size_t i = 0; i < count; ++i)
+			{
+				const color & c = src[i];
+				unsigned value = (narrow(c.r, 5) << 11) | (narrow(c.g, 5) << 6) | (narrow(c.b, 5) << 1) | narrow(c.a, 1);
+				dst[i * 2 + 0] = (unsigned char)value;
+				dst[i * 2 + 1] = (unsigned char)(value >> 8);
+			}
+			break;
+
+		case rgb888:
+			for (size_t i = 0; i < count; ++i)
+			{
+				dst[i * 3 + 0] = src[i].r;
+				dst[i * 3 + 1] = src[i].g;
+				dst[i * 3 + 2] = src[i].b;
+			}
+			break;
+
+		case a8:
+		case l8:
+		{
+			size_t i = 0;
+#ifdef PIXEL_FORMAT_SSE2
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i luma0, alpha0, luma1, alpha1;
+				luma_alpha(src + i, luma0, alpha0);
+				luma_alpha(src + i + 8, luma1, alpha1);
+				__m128i result = (format == a8) ? _mm_packus_epi16(alpha0, alpha1) : _mm_packus_epi16(luma0, luma1);
+				_mm_storeu_si128((__m128i *)(dst + i), result);
+			}
+#endif
+			for (; i < count; ++i)
+				dst[i] = (format == a8) ? src[i].a : luma(src[i]);
+			break;
+		}
+
+		case la88:
+		{
+			size_t i = 0;
+#ifdef PIXEL_FORMAT_SSE2
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i lum, alpha;
+				luma_alpha(src + i, lum, alpha);
+				_mm_storeu_si128((__m128i *)(dst + i * 2), _mm_or_si128(lum, _mm_slli_epi16(alpha, 8)));
+			}
+#endif
+			for (; i < count; ++i)
+			{
+				dst[i * 2 + 0] = luma(src[i]);
+				dst[i * 2 + 1] = src[i].a;
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	void unpack(const unsigned char * src, size_t count, pixel_format format, color * dst)
+	{
+		switch (format)
+		{
+		case rgba8888:
+			memcpy(dst, src, count * sizeof(color));
+			break;
+
+		case rgba4444:
+			for (size_t i = 0; i < count; ++i)
+			{
+				unsigned value = src[i * 2] | (src[i * 2 + 1] << 8);
+				dst[i].set(expand(value >> 12, 4), expand((value >> 8) & 15, 4),
+					expand((value >> 4) & 15, 4), expand(value & 15, 4));
+			}
+			break;
+
+		case rgb565:
+			for (size_t i = 0; i < count; ++i)
+			{
+				unsigned value = src[i * 2] | (src[i * 2 + 1] << 8);
+				dst[i].set(expand(value >> 11, 5), expand((value >> 5) & 63, 6), expand(value & 31, 5));
+			}
+			break;
+
+		case rgba5551:
+			for (size_t i = 0; i < count; ++i)
+			{
+				unsigned value = src[i * 2] | (src[i * 2 + 1] << 8);
+				dst[i].set(expand(value >> 11, 5), expand((value >> 6) & 31, 5),
+					expand((value >> 1) & 31, 5), expand(value & 1, 1));
+			}
+			break;
+
+		case rgb888:
+			for (size_t i = 0; i < count; ++i)
+				dst[i].set(src[i * 3 + 0], src[i * 3 + 1], src[i * 3 + 2]);
+			break;
+
+		case a8:
+			for (size_t i = 0; i < count; ++i)
+				dst[i].set(255, 255, 255, src[i]);
+			break;
+
+		case l8:
+			for (size_t i = 0; i < count; ++i)
+				dst[i].set(src[i], src[i], src[i]);
+			break;
+
+		case la88:
+			for (size_t i = 0; i < count; ++i)
+				dst[i].set(src[i * 2], src[i * 2], src[i * 2], src[i * 2 + 1]);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "color.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace img
+{
+	//GPU pixel formats textures can be stored in
+	enum pixel_format
+	{
+		//32 bits, 8 per channel
+		rgba8888,
+		//16 bits, 4 per channel
+		rgba4444,
+		//16 bits, no alpha
+		rgb565,
+		//16 bits, 1-bit alpha
+		rgba5551,
+		//24 bits, no alpha
+		rgb888,
+		//4x4 blocks, 8 bytes (DXT1, 1-bit alpha)
+		bc1,
+		//4x4 blocks, 16 bytes (DXT5)
+		bc3,
+		//4x4 blocks, 16 bytes
+		bc7,
+		//4x4 blocks, 8 bytes, no alpha
+		etc1,
+		//4x4 blocks, 16 bytes (ETC2 color and EAC alpha)
+		etc2_rgba,
+		//ASTC blocks, 16 bytes each (8, 3.56 and 2 bits per pixel)
+		astc_4x4,
+		astc_6x6,
+		astc_8x8,
+		//8 bits, alpha only (white)
+		a8,
+		//8 bits, luminance only (opaque gray, "L8" too)
+		l8,
+		//16 bits, luminance and alpha ("LA88" too)
+		la88,
+	};
+
+	//Dithering used when reducing to a format's precision
+	enum dither_mode
+	{
+		//Round to the nearest value
+		dither_none,
+		//4x4 Bayer matrix
+		dither_ordered,
+		//Floyd-Steinberg error diffusion
+		dither_floyd_steinberg,
+	};
+
+	//Format name as in Cocos2D .plist files (eg. "RGBA8888")
+	const char * format_name(pixel_format format);
+	//Find a format by its name (case insensitive), false if unknown
+	bool parse_format(const std::string & name, pixel_format & format);
+	//Bytes per pixel (uncompressed formats)
+	unsigned format_size(pixel_format format);
+	//Is the format block compressed
+	bool is_compressed(pixel_format format);
+	//Is the format one of the ASTC footprints
+	bool is_astc(pixel_format format);
+	//Block footprint and size in bytes (1x1 pixel blocks for uncompressed formats)
+	void format_block(pixel_format format, unsigned & width, unsigned & height, unsigned & bytes);
+	//Bits of each channel (R, G, B, A - 0 when the channel isn't stored)
+	void format_bits(pixel_format format, unsigned bits[4]);
+	//Find a dithering mode by its name ("none", "ordered", "floyd-steinberg"), false if unknown
+	bool parse_dither(const std::string & name, dither_mode & dither);
+
+	//Pack pixels into an uncompressed format, rounding to the nearest value (16-bit formats are little endian)
+	//Luminance is Rec. 601 luma, single channel formats are packed 16 pixels at a time with SSE2
+	void pack(const color * src, size_t count, pixel_format format, unsigned char * dst);
+	//Unpack pixels from an uncompressed format
+	void unpack(const unsigned char * src, size_t count, pixel_format format, color * dst);
+}
@@ -0,0 +1,97 @@
+#include "pkm.hpp"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	//PKM header (big endian)
+	struct pkm_header
+	{
+		char magic[4];
+		char version[2];
+		uint8_t type[2];
+		uint8_t padded_width[2];
+		uint8_t padded_height[2];
+		uint8_t width[2];
+		uint8_t height[2];
+	};
+
+	static_assert(sizeof(pkm_header) == 16, "PKM header must be 16 bytes");
+
+	const uint16_t pkm_etc1 = 0;
+	const uint16_t pkm_etc2_rgba = 3;
+
+	inline void put_be16(uint8_t * dst, unsigned value)
+	{
+		dst[0] = (uint8_t)(value >> 8);
+		dst[1] = (uint8_t)value;
+	}
+
+	void write_pkm(core::fwriter & fp, unsigned w, unsigned h, img::pixel_format format, std::vector<unsigned char> & blocks)
+	{
+		pkm_header header;
+		memcpy(header.magic, "PKM ", 4);
+		memcpy(header.version, format == img::etc1 ? "10" : "20", 2);
+		put_be16(header.type, format == img::etc1 ? pkm_etc1 : pkm_etc2_rgba);
+		put_be16(header.padded_width, (w + 3) & ~3u);
+		put_be16(header.padded_height, (h + 3) & ~3u);
+		put_be16(header.width, w);
+		put_be16(header.height, h);
+
+		fp.write(header);
+		fp.write(blocks.data(), 1, blocks.size());
+	}
+}
+
+namespace img
+{
+	pkm::pkm(unsigned w, unsigned h, pixel_format format, encode_quality quality, alpha_layout alpha)
+		: img(w, h)
+		, _format(format)
+		, _quality(quality)
+		, _alpha(alpha)
+	{ }
+
+	pkm::pkm() : img(), _format(etc1), _quality(quality_normal), _alpha(alpha_none) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void pkm::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+		if (_format != etc1 && _format != etc2_rgba)
+			throw std::exception("pkm supports ETC1 and ETC2_RGBA only");
+		if (_w > 0xFFFF || _h > 0xFFFF)
+			throw std::exception("pkm textures must be smaller than 65536");
+
+		auto blocks = encode_layout(*this, _format, _quality, _alpha);
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		write_pkm(fp, _w, layout_height(_h, _format, _alpha), _format, blocks);
+		fp.close();
+
+		if (_format != etc1 || _alpha != alpha_separate)
+			return;
+
+		blocks = encode_blocks(*this, _format, _quality, true);
+		auto alpha_fp = core::io::write(fname + "@alpha", true, false);
+		if (!alpha_fp.opened() || !alpha_fp.ok()) throw std::exception("cant open for writing");
+
+		write_pkm(alpha_fp, _w, _h, _format, blocks);
+		alpha_fp.close();
+	}
+
+	void pkm::load(const std::string &)
+	{
+		throw std::exception("pkm loading isn't supported");
+	}
+
+	void pkm::load(core::freader &)
+	{
+		throw std::exception("pkm loading isn't supported");
+	}
+}
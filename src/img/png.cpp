@@ -1,6 +1,11 @@
 #include "png.hpp"
+#include "analyze.hpp"
+#include "palette.hpp"
+#include "pixel_format.hpp"
 #include <stdio.h>
+#include <string.h>
 #include <pngstruct.h>
+#include <vector>
 
 namespace
 {
@@ -30,6 +35,7 @@ namespace
 	{
 		printf("[PNG] %s\n", warning_msg);
 	}
+
 }
 
 namespace img
@@ -52,15 +58,24 @@ namespace img
 		: img(w, h)
 		, _coltype(PNG_COLOR_TYPE_RGBA)
 		, _depth(8)
+		, _layout(png_rgba)
+		, _dither(dither_none)
 	{ }
 
 	png::png(const std::string & fname)
 		: img()
+		, _layout(png_rgba)
+		, _dither(dither_none)
 	{
 		load(fname);
 	}
 
-	png::png() : img() { }
+	png::png() : img(), _layout(png_rgba), _dither(dither_none) { }
+
+	bool png::sniff(const unsigned char * data, size_t size)
+	{
+		return size >= 8 && png_sig_cmp((png_const_bytep)data, 0, 8) == 0;
+	}
 
 	///////////////////////////////////////////////////////////////////////////
 
@@ -73,6 +88,8 @@ namespace img
 		//create file
 		auto fp = core::io::write(fname, true, false);
 		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+		//encode while the previous chunk is being written
+		fp.async(true);
 
 		//initialize stuff
 		png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -91,10 +108,53 @@ namespace img
 		if (setjmp(png_jmpbuf(png)))
 			throw std::exception("error writing header");
 
+		//256 colors at most, reduced if there are more
+		bool indexed = (_layout == png_indexed);
+		palette colors;
+		if (indexed)
+			colors = make_palette(*this, max_palette, _dither);
+
+		//gray layouts are packed like the matching pixel formats
+		int color_type = PNG_COLOR_TYPE_RGBA;
+		pixel_format row_format = rgba8888;
+		if (indexed)
+		{
+			color_type = PNG_COLOR_TYPE_PALETTE;
+		}
+		else if (_layout == png_gray)
+		{
+			color_type = PNG_COLOR_TYPE_GRAY;
+			row_format = l8;
+		}
+		else if (_layout == png_gray_alpha)
+		{
+			color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+			row_format = la88;
+		}
+
 		//set header
 		png_set_IHDR(png, info, _w, _h,
-			_depth, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+			_depth, color_type, PNG_INTERLACE_NONE,
 			PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+		if (indexed)
+		{
+			std::vector<png_color> plte(colors.colors.size());
+			std::vector<png_byte> trns;
+			for (size_t i = 0; i < colors.colors.size(); ++i)
+			{
+				const color & c = colors.colors[i];
+				plte[i].red = c.r;
+				plte[i].green = c.g;
+				plte[i].blue = c.b;
+				if (c.a != 255) trns.push_back(c.a);
+			}
+
+			png_set_PLTE(png, info, plte.data(), (int)plte.size());
+			if (!trns.empty())
+				png_set_tRNS(png, info, trns.data(), (int)trns.size(), nullptr);
+		}
+
 		//write header
 		png_write_info(png, info);
 
@@ -105,15 +165,15 @@ namespace img
 		byte ** rows = new byte*[_h];
 		for (unsigned y = 0; y < _h; ++y)
 		{
-			rows[y] = new byte[_w * 4];
-			for (unsigned x = 0; x < _w; ++x)
+			if (indexed)
 			{
-				color & c = _data[y*_w + x];
-				rows[y][x * 4 + 0] = c.r;
-				rows[y][x * 4 + 1] = c.g;
-				rows[y][x * 4 + 2] = c.b;
-				rows[y][x * 4 + 3] = c.a;
+				rows[y] = new byte[_w];
+				memcpy(rows[y], &colors.indices[(size_t)y * _w], _w);
+				continue;
 			}
+
+			rows[y] = new byte[_w * format_size(row_format)];
+			pack(&_data[(size_t)y * _w], _w, row_format, rows[y]);
 		}
 
 		png_write_image(png, rows);
@@ -21,10 +21,24 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 
 #pragma once
 #include "img.hpp"
+#include "pixel_format.hpp"
 #include <png.h>
 
 namespace img
 {
+	//How a PNG stores its pixels
+	enum png_layout
+	{
+		//8-bit RGBA
+		png_rgba,
+		//8-bit palette indices, reduced to 256 colors if there are more (see make_palette())
+		png_indexed,
+		//8-bit gray (Rec. 601 luma)
+		png_gray,
+		//8-bit gray and alpha
+		png_gray_alpha,
+	};
+
 	class png : public img
 	{
 		//color type
@@ -34,14 +48,26 @@ namespace img
 
 		//PNG passes (?)
 		int _passes;
+		//pixel layout written
+		png_layout _layout;
+		//dithering when reducing to a palette
+		dither_mode _dither;
 
 	public:
 		png();
 		png(const std::string & fname);
 		png(unsigned w, unsigned h);
 
+		//Set the pixel layout written
+		inline void layout(png_layout value) { _layout = value; }
+		//Set the dithering used when there are too many colors for a palette
+		inline void dither(dither_mode value) { _dither = value; }
+
 		void save(const std::string & fname) override;
 		void load(const std::string & fname) override;
 		void load(core::freader & reader) override;
+
+		//Does data start like a PNG file (at least 8 bytes)
+		static bool sniff(const unsigned char * data, size_t size);
 	};
 }
@@ -0,0 +1,249 @@
+#include "polygon.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+	//How far (in pixels) a corner is looked for around a cut down polygon's corner
+	const int snap_reach = 4;
+
+	struct vertex
+	{
+		double x, y;
+	};
+
+	inline int64_t cross(const util::point & o, const util::point & a, const util::point & b)
+	{
+		return (int64_t)(a.x - o.x) * (b.y - o.y) - (int64_t)(a.y - o.y) * (b.x - o.x);
+	}
+
+	//Convex hull (monotone chain), collinear points left out
+	std::vector<util::point> convex_hull(std::vector<util::point> & points)
+	{
+		std::sort(points.begin(), points.end(),
+			[](const util::point & a, const util::point & b) { return (a.x != b.x) ? (a.x < b.x) : (a.y < b.y); });
+		points.erase(std::unique(points.begin(), points.end(),
+			[](const util::point & a, const util::point & b) { return a.x == b.x && a.y == b.y; }), points.end());
+		if (points.size() < 3)
+			return points;
+
+		std::vector<util::point> hull(points.size() * 2);
+		size_t k = 0;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) --k;
+			hull[k++] = points[i];
+		}
+		for (size_t i = points.size() - 1, lower = k + 1; i > 0; --i)
+		{
+			while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0) --k;
+			hull[k++] = points[i - 1];
+		}
+
+		//The first point closes the chain
+		hull.resize(k - 1);
+		return hull;
+	}
+
+	//Where the edge before v[i] and the edge after v[i + 1] meet, if dropping the edge between them keeps the polygon convex
+	bool merge(const std::vector<vertex> & v, size_t i, double w, double h, vertex & result, double & added)
+	{
+		size_t n = v.size();
+		const vertex & a0 = v[(i + n - 1) % n];
+		const vertex & a1 = v[i];
+		const vertex & b0 = v[(i + 1) % n];
+		const vertex & b1 = v[(i + 2) % n];
+
+		double dax = a1.x - a0.x, day = a1.y - a0.y;
+		double dbx = b1.x - b0.x, dby = b1.y - b0.y;
+		double denom = dax * dby - day * dbx;
+		if (fabs(denom) < 1e-9)
+			return false;
+
+		//The lines must meet ahead of a1 and behind b0
+		double t = ((b0.x - a0.x) * dby - (b0.y - a0.y) * dbx) / denom;
+		double s = ((b0.x - a0.x) * day - (b0.y - a0.y) * dax) / denom;
+		if (t <= 1.0 || s >= 0.0)
+			return false;
+
+		result.x = a0.x + dax * t;
+		result.y = a0.y + day * t;
+		if (result.x < 0.0 || result.y < 0.0 || result.x > w || result.y > h)
+			return false;
+
+		added = fabs((b0.x - a1.x) * (result.y - a1.y) - (b0.y - a1.y) * (result.x - a1.x)) / 2.0;
+		return true;
+	}
+
+	//Cut a convex polygon down to max_vertices corners, dropping the edge whose neighbours meet adding the least area
+	//Stops early if no edge can go without the polygon leaving the area
+	std::vector<vertex> reduce(const std::vector<util::point> & hull, unsigned max_vertices, double w, double h)
+	{
+		std::vector<vertex> polygon;
+		for (auto & p : hull)
+			polygon.push_back({ (double)p.x, (double)p.y });
+
+		while (polygon.size() > max_vertices)
+		{
+			size_t best = polygon.size();
+			vertex best_vertex = { 0.0, 0.0 };
+			double best_added = 0.0;
+			for (size_t i = 0; i < polygon.size(); ++i)
+			{
+				vertex merged;
+				double added;
+				if (merge(polygon, i, w, h, merged, added) && (best == polygon.size() || added < best_added))
+				{
+					best = i;
+					best_vertex = merged;
+					best_added = added;
+				}
+			}
+
+			if (best == polygon.size())
+				break;
+
+			//v[best] becomes the meeting point, v[best + 1] goes
+			polygon[best] = best_vertex;
+			polygon.erase(polygon.begin() + (best + 1) % polygon.size());
+		}
+
+		return polygon;
+	}
+
+	//Move every corner to a pixel corner in the area, where the polygon only grows, and take the hull of them
+	//A corner may go anywhere between the outward extensions of its edges, as it then still covers its old place
+	//False if a corner has no pixel corner there within reach
+	bool snap(std::vector<vertex> polygon, int w, int h, std::vector<util::point> & result)
+	{
+		std::vector<util::point> points;
+		size_t n = polygon.size();
+		for (size_t i = 0; i < n; ++i)
+		{
+			const vertex & v = polygon[i];
+			const vertex & prev = polygon[(i + n - 1) % n];
+			const vertex & next = polygon[(i + 1) % n];
+			double ux = v.x - prev.x, uy = v.y - prev.y;
+			double vx = v.x - next.x, vy = v.y - next.y;
+			double denom = ux * vy - uy * vx;
+
+			//Nearest pixel corner p = v + s * u + t * v with s, t >= 0
+			bool found = false;
+			util::point best(0, 0);
+			double best_distance = 0.0;
+			for (int reach = 1; reach <= snap_reach && !found; ++reach)
+			{
+				for (int y = (int)floor(v.y) - reach + 1; y <= (int)floor(v.y) + reach; ++y)
+				{
+					for (int x = (int)floor(v.x) - reach + 1; x <= (int)floor(v.x) + reach; ++x)
+					{
+						if (x < 0 || y < 0 || x > w || y > h)
+							continue;
+
+						double dx = x - v.x, dy = y - v.y;
+						if (fabs(denom) < 1e-9)
+						{
+							//A straight corner, it can only move along its edges
+							if (fabs(ux * dy - uy * dx) > 1e-9) continue;
+						}
+						else if ((dx * vy - dy * vx) / denom < -1e-9 || (ux * dy - uy * dx) / denom < -1e-9)
+						{
+							continue;
+						}
+
+						double distance = dx * dx + dy * dy;
+						if (!found || distance < best_distance)
+						{
+							found = true;
+							best = util::point(x, y);
+							best_distance = distance;
+						}
+					}
+				}
+			}
+
+			if (!found)
+				return false;
+
+			//Later corners are moved around this one's new place
+			polygon[i] = { (double)best.x, (double)best.y };
+			points.push_back(best);
+		}
+
+		result = convex_hull(points);
+		return true;
+	}
+
+	//Are all points inside or on a convex polygon
+	bool covers(const std::vector<util::point> & polygon, const std::vector<util::point> & points)
+	{
+		for (auto & p : points)
+		{
+			bool left = false, right = false;
+			for (size_t i = 0; i < polygon.size(); ++i)
+			{
+				int64_t side = cross(polygon[i], polygon[(i + 1) % polygon.size()], p);
+				if (side > 0) left = true;
+				if (side < 0) right = true;
+			}
+
+			if (left && right)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+namespace img
+{
+	mesh polygon_mesh(const img & image, const util::rect & area, unsigned max_vertices)
+	{
+		mesh result;
+
+		//Outer corners of the visible span of every row
+		std::vector<util::point> points;
+		for (int y = 0; y < area.h; ++y)
+		{
+			const color * row = (const color *)image.data() + (size_t)(area.y + y) * image.w() + area.x;
+			int left = 0, right = area.w - 1;
+			while (left < area.w && row[left].a == 0) ++left;
+			if (left == area.w) continue;
+			while (row[right].a == 0) --right;
+
+			points.push_back(util::point(left, y));
+			points.push_back(util::point(left, y + 1));
+			points.push_back(util::point(right + 1, y));
+			points.push_back(util::point(right + 1, y + 1));
+		}
+
+		std::vector<util::point> hull = convex_hull(points);
+		if (hull.size() < 3)
+			return result;
+
+		//Polygons with few enough corners are taken as they are
+		//Cut down ones have to land on pixel corners and still cover the hull, they get a corner more until they do
+		max_vertices = std::max(max_vertices, 3u);
+		result.vertices = hull;
+		for (unsigned n = max_vertices; n < hull.size(); ++n)
+		{
+			std::vector<util::point> snapped;
+			if (snap(reduce(hull, n, area.w, area.h), area.w, area.h, snapped) && snapped.size() >= 3 && covers(snapped, hull))
+			{
+				result.vertices.swap(snapped);
+				break;
+			}
+		}
+
+		//Convex, so a fan does
+		for (unsigned i = 1; i + 1 < result.vertices.size(); ++i)
+		{
+			result.triangles.push_back(0);
+			result.triangles.push_back(i);
+			result.triangles.push_back(i + 1);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,45 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "img.hpp"
+#include "../util/point.hpp"
+#include "../util/rect.hpp"
+
+#include <vector>
+
+namespace img
+{
+	//Triangles covering the visible pixels of a sprite, so renderers skip its empty space
+	struct mesh
+	{
+		//Corners in pixels, on pixel edges (y goes down)
+		std::vector<util::point> vertices;
+		//Vertex indices, 3 per triangle
+		std::vector<unsigned> triangles;
+	};
+
+	//Convex polygon around the pixels with alpha in an area of an image, fanned into triangles
+	//The hull is cut down to max_vertices corners on pixel edges, growing it as little as possible but never past the area
+	//It keeps more corners where none can go without leaving the area (a rect keeps 4 for 3) or without uncovering a pixel once on pixel edges
+	//Vertices are relative to the area, the mesh is empty if nothing is visible
+	mesh polygon_mesh(const img & image, const util::rect & area, unsigned max_vertices);
+}
@@ -0,0 +1,232 @@
+#include "pvr.hpp"
+#include "png.hpp"
+#include "../util/parallel.hpp"
+#include <zlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	//PVR v3 header (little endian)
+#pragma pack(push, 1)
+	struct pvr_header
+	{
+		uint32_t version;
+		uint32_t flags;
+		uint64_t pixel_format;
+		uint32_t color_space;
+		uint32_t channel_type;
+		uint32_t height;
+		uint32_t width;
+		uint32_t depth;
+		uint32_t surfaces;
+		uint32_t faces;
+		uint32_t mipmaps;
+		uint32_t metadata_size;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(pvr_header) == 52, "PVR v3 header must be 52 bytes");
+
+	//"PVR\3"
+	const uint32_t pvr_version = 0x03525650;
+
+	//CCZ container magic
+	const char ccz_magic[4] = { 'C', 'C', 'Z', '!' };
+	//CCZ header size (magic, compression type, version, reserved, uncompressed size - big endian)
+	const size_t ccz_header_size = 16;
+	//zlib compression in CCZ
+	const uint16_t ccz_zlib = 0;
+	//Newest CCZ version Cocos2D reads
+	const uint16_t ccz_version = 2;
+
+	//PVR channel layout, channel names in the low bytes and bit counts in the high bytes
+	uint64_t pvr_format(img::pixel_format format)
+	{
+		switch (format)
+		{
+		case img::rgba4444: return 0x0404040461626772ULL;
+		case img::rgb565: return 0x0005060500626772ULL;
+		case img::rgba5551: return 0x0105050561626772ULL;
+		case img::rgb888: return 0x0008080800626772ULL;
+		case img::a8: return 0x0000000800000061ULL;
+		case img::l8: return 0x000000080000006CULL;
+		case img::la88: return 0x000008080000616CULL;
+		default: return 0x0808080861626772ULL;
+		}
+	}
+
+	void put_be16(unsigned char * ptr, uint16_t value)
+	{
+		ptr[0] = (unsigned char)(value >> 8);
+		ptr[1] = (unsigned char)value;
+	}
+
+	void put_be32(unsigned char * ptr, uint32_t value)
+	{
+		ptr[0] = (unsigned char)(value >> 24);
+		ptr[1] = (unsigned char)(value >> 16);
+		ptr[2] = (unsigned char)(value >> 8);
+		ptr[3] = (unsigned char)value;
+	}
+
+	uint32_t get_be32(const unsigned char * ptr)
+	{
+		return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+	}
+}
+
+namespace img
+{
+	pvr::pvr(unsigned w, unsigned h, pixel_format format, bool ccz)
+		: img(w, h)
+		, _format(format)
+		, _ccz(ccz)
+	{ }
+
+	pvr::pvr(const std::string & fname)
+		: img()
+		, _format(rgba8888)
+		, _ccz(false)
+	{
+		load(fname);
+	}
+
+	pvr::pvr() : img(), _format(rgba8888), _ccz(false) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void pvr::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+
+		pvr_header header;
+		memset(&header, 0, sizeof(header));
+		header.version = pvr_version;
+		header.pixel_format = pvr_format(_format);
+		header.height = _h;
+		header.width = _w;
+		header.depth = 1;
+		header.surfaces = 1;
+		header.faces = 1;
+		header.mipmaps = (uint32_t)(1 + _mips.size());
+
+		std::vector<const img *> levels(1, this);
+		levels.insert(levels.end(), _mips.begin(), _mips.end());
+
+		//header and pixels of all levels (largest first) in one block, compressed at once
+		size_t pixel_size = format_size(_format);
+		size_t size = sizeof(header);
+		for (auto level : levels)
+			size += (size_t)level->w() * level->h() * pixel_size;
+		std::vector<byte> texture(size);
+		memcpy(texture.data(), &header, sizeof(header));
+
+		byte * dst = texture.data() + sizeof(header);
+		for (auto level : levels)
+		{
+			unsigned w = level->w();
+			const color * src = (const color *)level->data();
+			util::parallel_bands(level->h(), 64, [&](size_t begin, size_t end) {
+				pack(src + begin * w, (end - begin) * w, _format, dst + begin * w * pixel_size);
+			});
+			dst += (size_t)w * level->h() * pixel_size;
+		}
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		if (!_ccz)
+		{
+			fp.write(texture.data(), 1, texture.size());
+			fp.close();
+			return;
+		}
+
+		uLongf packed_size = compressBound((uLong)texture.size());
+		std::vector<byte> packed(ccz_header_size + packed_size);
+		if (compress2(packed.data() + ccz_header_size, &packed_size, texture.data(), (uLong)texture.size(), Z_BEST_COMPRESSION) != Z_OK)
+			throw std::exception("cant compress");
+
+		memcpy(packed.data(), ccz_magic, sizeof(ccz_magic));
+		put_be16(packed.data() + 4, ccz_zlib);
+		put_be16(packed.data() + 6, ccz_version);
+		put_be32(packed.data() + 8, 0);
+		put_be32(packed.data() + 12, (uint32_t)texture.size());
+
+		fp.write(packed.data(), 1, ccz_header_size + packed_size);
+		fp.close();
+	}
+
+	void pvr::load(const std::string & fname)
+	{
+		//Open file
+		auto fp = core::io::read(fname, true);
+		if (!fp.opened() || !fp.ok())
+			throw std::exception("cant open file");
+
+		//Read using file reader object
+		load(fp);
+
+		//close
+		fp.close();
+	}
+
+	void pvr::load(core::freader & reader)
+	{
+		std::string content;
+		reader.readrest(content);
+		const byte * ptr = (const byte *)content.data();
+		size_t size = content.size();
+
+		//Unwrap CCZ
+		std::vector<byte> texture;
+		_ccz = (size >= ccz_header_size && memcmp(ptr, ccz_magic, sizeof(ccz_magic)) == 0);
+		if (_ccz)
+		{
+			uLongf unpacked_size = get_be32(ptr + 12);
+			texture.resize(unpacked_size);
+			if (uncompress(texture.data(), &unpacked_size, ptr + ccz_header_size, (uLong)(size - ccz_header_size)) != Z_OK)
+				throw std::exception("corrupt ccz");
+
+			ptr = texture.data();
+			size = unpacked_size;
+		}
+
+		pvr_header header;
+		if (size < sizeof(header))
+			throw std::exception("not pvr");
+		memcpy(&header, ptr, sizeof(header));
+		if (header.version != pvr_version)
+			throw std::exception("not pvr");
+
+		static const pixel_format formats[] = { rgba8888, rgba4444, rgb565, rgba5551, rgb888, a8, l8, la88 };
+		bool known = false;
+		for (auto fmt : formats)
+			if (header.pixel_format == pvr_format(fmt))
+			{
+				_format = fmt;
+				known = true;
+			}
+
+		if (!known)
+			throw std::exception("unsupported pvr pixel format");
+
+		size_t offset = sizeof(header) + header.metadata_size;
+		size_t pixels = (size_t)header.width * header.height;
+		if (offset > size || (size - offset) / format_size(_format) < pixels)
+			throw std::exception("truncated pvr");
+
+		//cleanup data
+		if (_data != nullptr)
+			delete[] _data;
+
+		//only the first surface is loaded
+		_w = header.width;
+		_h = header.height;
+		_data = new color[pixels];
+		unpack(ptr + offset, pixels, _format, _data);
+	}
+}
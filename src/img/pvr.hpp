@@ -0,0 +1,50 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "img.hpp"
+#include "pixel_format.hpp"
+
+namespace img
+{
+	//PVR v3 texture with raw pixels, optionally zlib compressed in a CCZ container (.pvr.ccz)
+	//Loading one at runtime is a single inflate, without any decoding
+	class pvr : public img
+	{
+		//payload pixel format
+		pixel_format _format;
+		//wrap in CCZ
+		bool _ccz;
+
+	public:
+		pvr();
+		pvr(const std::string & fname);
+		pvr(unsigned w, unsigned h, pixel_format format = rgba8888, bool ccz = false);
+
+		//Payload pixel format
+		inline pixel_format format() const { return _format; }
+		//Is the texture CCZ compressed
+		inline bool ccz() const { return _ccz; }
+
+		void save(const std::string & fname) override;
+		void load(const std::string & fname) override;
+		void load(core::freader & reader) override;
+	};
+}
@@ -0,0 +1,273 @@
+#include "qoi.hpp"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	//File signature
+	const unsigned char qoi_magic[4] = { 'q', 'o', 'i', 'f' };
+	//Header: magic, width, height (big endian), channels, colorspace
+	const size_t qoi_header_size = 14;
+	//Stream end: 7 zero bytes and a 1
+	const unsigned char qoi_padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	//Refuse images bigger than this many pixels (corrupt headers)
+	const size_t qoi_max_pixels = 400000000;
+
+	//Chunk tags
+	const unsigned char op_index = 0x00;
+	const unsigned char op_diff = 0x40;
+	const unsigned char op_luma = 0x80;
+	const unsigned char op_run = 0xC0;
+	const unsigned char op_rgb = 0xFE;
+	const unsigned char op_rgba = 0xFF;
+	const unsigned char op_mask = 0xC0;
+
+	//Longest run of one chunk (62 - 63 and 64 would collide with op_rgb and op_rgba)
+	const unsigned max_run = 62;
+
+	inline unsigned color_hash(const img::color & c)
+	{
+		return (c.r * 3 + c.g * 5 + c.b * 7 + c.a * 11) % 64;
+	}
+
+	inline bool same(const img::color & a, const img::color & b)
+	{
+		return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+	}
+
+	inline void put_be32(unsigned char * dst, uint32_t value)
+	{
+		dst[0] = (unsigned char)(value >> 24);
+		dst[1] = (unsigned char)(value >> 16);
+		dst[2] = (unsigned char)(value >> 8);
+		dst[3] = (unsigned char)value;
+	}
+
+	inline uint32_t get_be32(const unsigned char * src)
+	{
+		return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
+	}
+}
+
+namespace img
+{
+	qoi::qoi() : img() { }
+
+	qoi::qoi(const std::string & fname) : img()
+	{
+		load(fname);
+	}
+
+	qoi::qoi(unsigned w, unsigned h) : img(w, h) { }
+
+	bool qoi::sniff(const unsigned char * data, size_t size)
+	{
+		return size >= sizeof(qoi_magic) && memcmp(data, qoi_magic, sizeof(qoi_magic)) == 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void qoi::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+
+		size_t count = (size_t)_w * _h;
+		bool opaque = true;
+		for (size_t i = 0; i < count && opaque; ++i)
+			opaque = (_data[i].a == 255);
+
+		//Worst case is op_rgba for every pixel
+		std::vector<unsigned char> out(qoi_header_size + count * 5 + sizeof(qoi_padding));
+		unsigned char * dst = out.data();
+		memcpy(dst, qoi_magic, sizeof(qoi_magic));
+		put_be32(dst + 4, _w);
+		put_be32(dst + 8, _h);
+		//Channels are informative only, the stream is the same
+		dst[12] = opaque ? 3 : 4;
+		//sRGB with linear alpha
+		dst[13] = 0;
+		dst += qoi_header_size;
+
+		color index[64];
+		std::fill(index, index + 64, color(0, 0, 0, 0));
+		color prev(0, 0, 0, 255);
+		unsigned run = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const color & px = _data[i];
+			if (same(px, prev))
+			{
+				if (++run == max_run || i + 1 == count)
+				{
+					*dst++ = (unsigned char)(op_run | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				*dst++ = (unsigned char)(op_run | (run - 1));
+				run = 0;
+			}
+
+			unsigned hash = color_hash(px);
+			if (same(index[hash], px))
+			{
+				*dst++ = (unsigned char)(op_index | hash);
+			}
+			else
+			{
+				index[hash] = px;
+				if (px.a == prev.a)
+				{
+					//Differences wrap around like the decoder's byte arithmetic
+					int dr = (signed char)(px.r - prev.r);
+					int dg = (signed char)(px.g - prev.g);
+					int db = (signed char)(px.b - prev.b);
+					int dr_dg = dr - dg;
+					int db_dg = db - dg;
+
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+					{
+						*dst++ = (unsigned char)(op_diff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+					}
+					else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+					{
+						*dst++ = (unsigned char)(op_luma | (dg + 32));
+						*dst++ = (unsigned char)(((dr_dg + 8) << 4) | (db_dg + 8));
+					}
+					else
+					{
+						*dst++ = op_rgb;
+						*dst++ = px.r;
+						*dst++ = px.g;
+						*dst++ = px.b;
+					}
+				}
+				else
+				{
+					*dst++ = op_rgba;
+					*dst++ = px.r;
+					*dst++ = px.g;
+					*dst++ = px.b;
+					*dst++ = px.a;
+				}
+			}
+
+			prev = px;
+		}
+
+		memcpy(dst, qoi_padding, sizeof(qoi_padding));
+		dst += sizeof(qoi_padding);
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		fp.write(out.data(), 1, dst - out.data());
+		fp.close();
+	}
+
+	void qoi::load(const std::string & fname)
+	{
+		auto fp = core::io::read(fname, true);
+		if (!fp.opened() || !fp.ok())
+			throw std::exception("cant open file");
+
+		load(fp);
+		fp.close();
+	}
+
+	void qoi::load(core::freader & reader)
+	{
+		unsigned char header[qoi_header_size];
+		if (reader.read(header, 1, sizeof(header)) != sizeof(header) || !sniff(header, sizeof(header)))
+			throw std::exception("not qoi");
+
+		unsigned w = get_be32(header + 4);
+		unsigned h = get_be32(header + 8);
+		if (w == 0 || h == 0 || (size_t)w * h > qoi_max_pixels)
+			throw std::exception("bad qoi size");
+
+		std::string stream;
+		reader.readrest(stream);
+		const unsigned char * src = (const unsigned char *)stream.data();
+		//Chunks never run into the padding
+		size_t end = (stream.size() > sizeof(qoi_padding)) ? stream.size() - sizeof(qoi_padding) : 0;
+
+		if (_data != nullptr)
+			delete[] _data;
+		_w = w;
+		_h = h;
+		_data = new color[(size_t)w * h];
+
+		color index[64];
+		std::fill(index, index + 64, color(0, 0, 0, 0));
+		color px(0, 0, 0, 255);
+		unsigned run = 0;
+		size_t p = 0;
+
+		size_t count = (size_t)w * h;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (run > 0)
+			{
+				--run;
+			}
+			else if (p < end)
+			{
+				unsigned char b1 = src[p++];
+				if (b1 == op_rgb)
+				{
+					if (p + 3 > end) throw std::exception("truncated qoi");
+					px.r = src[p];
+					px.g = src[p + 1];
+					px.b = src[p + 2];
+					p += 3;
+				}
+				else if (b1 == op_rgba)
+				{
+					if (p + 4 > end) throw std::exception("truncated qoi");
+					px.set(src[p], src[p + 1], src[p + 2], src[p + 3]);
+					p += 4;
+				}
+				else if ((b1 & op_mask) == op_index)
+				{
+					px = index[b1];
+				}
+				else if ((b1 & op_mask) == op_diff)
+				{
+					px.r += ((b1 >> 4) & 3) - 2;
+					px.g += ((b1 >> 2) & 3) - 2;
+					px.b += (b1 & 3) - 2;
+				}
+				else if ((b1 & op_mask) == op_luma)
+				{
+					if (p + 1 > end) throw std::exception("truncated qoi");
+					unsigned char b2 = src[p++];
+					int dg = (b1 & 0x3F) - 32;
+					px.r += dg - 8 + ((b2 >> 4) & 0x0F);
+					px.g += dg;
+					px.b += dg - 8 + (b2 & 0x0F);
+				}
+				else
+				{
+					run = b1 & 0x3F;
+				}
+
+				index[color_hash(px)] = px;
+			}
+			else
+			{
+				throw std::exception("truncated qoi");
+			}
+
+			_data[i] = px;
+		}
+	}
+}
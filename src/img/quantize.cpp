@@ -0,0 +1,252 @@
+#include "quantize.hpp"
+#include "../util/parallel.hpp"
+
+#include <string.h>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define QUANTIZE_SSE2 1
+#endif
+
+namespace
+{
+	//Rows per band when splitting work between threads
+	const size_t min_band_rows = 32;
+
+	//4x4 Bayer matrix (0..15)
+	const int bayer[4][4] = {
+		{  0,  8,  2, 10 },
+		{ 12,  4, 14,  6 },
+		{  3, 11,  1,  9 },
+		{ 15,  7, 13,  5 },
+	};
+
+	//Per channel lookup tables for a pixel format
+	struct tables
+	{
+		//Nearest representable value of every 8-bit value
+		unsigned char nearest[4][256];
+		//Distance between two representable values (0 if the channel is exact)
+		int step[4];
+
+		tables(img::pixel_format format)
+		{
+			unsigned bits[4];
+			img::format_bits(format, bits);
+
+			for (int ch = 0; ch < 4; ++ch)
+			{
+				//Missing channels are dropped - alpha reads as opaque
+				if (bits[ch] == 0)
+				{
+					memset(nearest[ch], 255, 256);
+					step[ch] = 0;
+					continue;
+				}
+
+				unsigned max = (1u << bits[ch]) - 1;
+				for (unsigned value = 0; value < 256; ++value)
+				{
+					unsigned level = (value * max + 127) / 255;
+					nearest[ch][value] = (unsigned char)((level * 255 + max / 2) / max);
+				}
+
+				step[ch] = (bits[ch] >= 8) ? 0 : (int)(255 / max);
+			}
+		}
+	};
+
+	inline unsigned char clamp(int value)
+	{
+		return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+	}
+
+	void nearest_rows(const tables & tbl, img::color * pixels, unsigned w, size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			img::color * row = pixels + y * w;
+			for (unsigned x = 0; x < w; ++x)
+			{
+				row[x].r = tbl.nearest[0][row[x].r];
+				row[x].g = tbl.nearest[1][row[x].g];
+				row[x].b = tbl.nearest[2][row[x].b];
+				row[x].a = tbl.nearest[3][row[x].a];
+			}
+		}
+	}
+
+	void ordered_rows(const tables & tbl, img::color * pixels, unsigned w, size_t begin, size_t end)
+	{
+		//Threshold for every byte of 4 pixels (the matrix repeats every 4 pixels = 16 bytes)
+		//Split into positive and negative parts for saturating unsigned adds
+		unsigned char up[4][16], down[4][16];
+		for (int my = 0; my < 4; ++my)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				int ch = i % 4;
+				int bias = ((2 * bayer[my][i / 4] + 1) * tbl.step[ch]) / 32 - tbl.step[ch] / 2;
+				up[my][i] = (unsigned char)(bias > 0 ? bias : 0);
+				down[my][i] = (unsigned char)(bias < 0 ? -bias : 0);
+			}
+		}
+
+		for (size_t y = begin; y < end; ++y)
+		{
+			img::color * row = pixels + y * w;
+			unsigned char * bytes = (unsigned char *)row;
+			const unsigned char * row_up = up[y % 4];
+			const unsigned char * row_down = down[y % 4];
+			unsigned x = 0;
+
+#ifdef QUANTIZE_SSE2
+			__m128i vup = _mm_loadu_si128((const __m128i *)row_up);
+			__m128i vdown = _mm_loadu_si128((const __m128i *)row_down);
+			for (; x + 4 <= w; x += 4)
+			{
+				__m128i * ptr = (__m128i *)(bytes + x * 4);
+				__m128i value = _mm_loadu_si128(ptr);
+				value = _mm_subs_epu8(_mm_adds_epu8(value, vup), vdown);
+				_mm_storeu_si128(ptr, value);
+			}
+#endif
+			for (; x < w; ++x)
+			{
+				for (int ch = 0; ch < 4; ++ch)
+				{
+					int i = (x % 4) * 4 + ch;
+					bytes[x * 4 + ch] = clamp(bytes[x * 4 + ch] + row_up[i] - row_down[i]);
+				}
+			}
+		}
+
+		nearest_rows(tbl, pixels, w, begin, end);
+	}
+
+	//x * a / 255, rounded to the nearest (exact for all 8-bit x and a)
+	inline unsigned char mul255(unsigned x, unsigned a)
+	{
+		unsigned t = x * a + 128;
+		return (unsigned char)((t + (t >> 8)) >> 8);
+	}
+
+	void premultiply_rows(img::color * pixels, unsigned w, size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			img::color * row = pixels + y * w;
+			unsigned x = 0;
+#ifdef QUANTIZE_SSE2
+			//Two pixels per 16-bit half, alpha is multiplied by 255 so it stays as is
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16(128);
+			const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+			for (; x + 4 <= w; x += 4)
+			{
+				__m128i * ptr = (__m128i *)(row + x);
+				__m128i value = _mm_loadu_si128(ptr);
+				__m128i halves[2] = { _mm_unpacklo_epi8(value, zero), _mm_unpackhi_epi8(value, zero) };
+				for (auto & half : halves)
+				{
+					__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(half, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+					__m128i t = _mm_add_epi16(_mm_mullo_epi16(half, _mm_or_si128(alpha, alpha_lanes)), bias);
+					half = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+				}
+				_mm_storeu_si128(ptr, _mm_packus_epi16(halves[0], halves[1]));
+			}
+#endif
+			for (; x < w; ++x)
+			{
+				img::color & c = row[x];
+				c.r = mul255(c.r, c.a);
+				c.g = mul255(c.g, c.a);
+				c.b = mul255(c.b, c.a);
+			}
+		}
+	}
+
+	//Serpentine Floyd-Steinberg - every row depends on the one above, so this one stays serial
+	void floyd_steinberg(const tables & tbl, img::color * pixels, unsigned w, unsigned h)
+	{
+		//Error carried into the current and the next row (1 pixel margin on both sides)
+		std::vector<int> current((w + 2) * 4, 0), next((w + 2) * 4, 0);
+
+		for (unsigned y = 0; y < h; ++y)
+		{
+			bool reverse = (y % 2) != 0;
+			int dir = reverse ? -1 : 1;
+			unsigned char * bytes = (unsigned char *)(pixels + (size_t)y * w);
+
+			for (unsigned i = 0; i < w; ++i)
+			{
+				unsigned x = reverse ? (w - 1 - i) : i;
+				for (int ch = 0; ch < 4; ++ch)
+				{
+					unsigned char & value = bytes[x * 4 + ch];
+					//Keep fully transparent and opaque pixels as they are, or edges would bleed into them
+					if (tbl.step[ch] == 0 || (ch == 3 && (value == 0 || value == 255)))
+					{
+						value = tbl.nearest[ch][value];
+						continue;
+					}
+
+					int wanted = value + current[(x + 1) * 4 + ch] / 16;
+					unsigned char result = tbl.nearest[ch][clamp(wanted)];
+					int error = wanted - result;
+					value = result;
+
+					current[(x + 1 + dir) * 4 + ch] += error * 7;
+					next[(x + 1 - dir) * 4 + ch] += error * 3;
+					next[(x + 1) * 4 + ch] += error * 5;
+					next[(x + 1 + dir) * 4 + ch] += error;
+				}
+			}
+
+			current.swap(next);
+			std::fill(next.begin(), next.end(), 0);
+		}
+	}
+}
+
+namespace img
+{
+	void quantize(img & image, pixel_format format, dither_mode dither)
+	{
+		if (format == rgba8888 || is_compressed(format) || image.data() == nullptr)
+			return;
+
+		const tables tbl(format);
+		color * pixels = (color *)image.data();
+		unsigned w = image.w();
+
+		switch (dither)
+		{
+		case dither_floyd_steinberg:
+			floyd_steinberg(tbl, pixels, w, image.h());
+			break;
+
+		case dither_ordered:
+			util::parallel_bands(image.h(), min_band_rows,
+				[&](size_t begin, size_t end) { ordered_rows(tbl, pixels, w, begin, end); });
+			break;
+
+		default:
+			util::parallel_bands(image.h(), min_band_rows,
+				[&](size_t begin, size_t end) { nearest_rows(tbl, pixels, w, begin, end); });
+			break;
+		}
+	}
+
+	void premultiply(img & image)
+	{
+		if (image.data() == nullptr)
+			return;
+
+		color * pixels = (color *)image.data();
+		unsigned w = image.w();
+		util::parallel_bands(image.h(), min_band_rows,
+			[&](size_t begin, size_t end) { premultiply_rows(pixels, w, begin, end); });
+	}
+}
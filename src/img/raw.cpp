@@ -0,0 +1,57 @@
+#include "raw.hpp"
+#include <zlib.h>
+#include <vector>
+
+namespace img
+{
+	raw::raw(unsigned w, unsigned h, pixel_format format, bool zlib)
+		: img(w, h)
+		, _format(format)
+		, _zlib(zlib)
+	{ }
+
+	raw::raw() : img(), _format(rgba8888), _zlib(false) { }
+
+	///////////////////////////////////////////////////////////////////////////
+
+	void raw::save(const std::string & fname)
+	{
+		//Check if data isn't present
+		if (_data == nullptr)
+			throw std::exception("data isn't present");
+		if (is_compressed(_format))
+			throw std::exception("raw files support uncompressed formats only");
+
+		std::vector<unsigned char> pixels((size_t)_w * _h * format_size(_format));
+		pack(_data, (size_t)_w * _h, _format, pixels.data());
+
+		auto fp = core::io::write(fname, true, false);
+		if (!fp.opened() || !fp.ok()) throw std::exception("cant open for writing");
+
+		if (!_zlib)
+		{
+			fp.write(pixels.data(), 1, pixels.size());
+			fp.close();
+			return;
+		}
+
+		//A plain zlib stream, the reader knows the size from the index
+		uLongf packed_size = compressBound((uLong)pixels.size());
+		std::vector<unsigned char> packed(packed_size);
+		if (compress2(packed.data(), &packed_size, pixels.data(), (uLong)pixels.size(), Z_BEST_COMPRESSION) != Z_OK)
+			throw std::exception("cant compress");
+
+		fp.write(packed.data(), 1, packed_size);
+		fp.close();
+	}
+
+	void raw::load(const std::string &)
+	{
+		throw std::exception("raw loading isn't supported");
+	}
+
+	void raw::load(core::freader &)
+	{
+		throw std::exception("raw loading isn't supported");
+	}
+}
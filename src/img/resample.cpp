@@ -0,0 +1,180 @@
+#include "resample.hpp"
+#include "png.hpp"
+#include "../util/parallel.hpp"
+
+#include <math.h>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define RESAMPLE_SSE2 1
+#endif
+
+namespace
+{
+	//Rows per band when splitting work between threads
+	const size_t min_band_rows = 16;
+	const float pi = 3.14159265358979f;
+
+	//A premultiplied pixel (r * a, g * a, b * a, a), 0..255
+	struct pixel
+	{
+		float v[4];
+	};
+
+	float mitchell(float x)
+	{
+		const float b = 1.0f / 3.0f, c = 1.0f / 3.0f;
+		x = fabsf(x);
+		if (x < 1.0f)
+			return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x + (6 - 2 * b)) / 6.0f;
+		if (x < 2.0f)
+			return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x + (-12 * b - 48 * c) * x + (8 * b + 24 * c)) / 6.0f;
+		return 0.0f;
+	}
+
+	float sinc(float x)
+	{
+		if (fabsf(x) < 1e-6f) return 1.0f;
+		return sinf(pi * x) / (pi * x);
+	}
+
+	float lanczos3(float x)
+	{
+		return (fabsf(x) < 3.0f) ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+	}
+
+	//Source pixels and weights of every destination pixel along one axis
+	struct contributions
+	{
+		std::vector<unsigned> first;
+		std::vector<unsigned> count;
+		std::vector<float> weights;
+		unsigned stride;
+
+		contributions(unsigned src, unsigned dst, img::resample_filter filter)
+		{
+			float support = (filter == img::filter_lanczos3) ? 3.0f : 2.0f;
+			float (*kernel)(float) = (filter == img::filter_lanczos3) ? lanczos3 : mitchell;
+
+			//Downscaling widens the filter so every source pixel counts
+			float scale = (float)dst / src;
+			float stretch = (scale < 1.0f) ? 1.0f / scale : 1.0f;
+			float radius = support * stretch;
+
+			stride = (unsigned)ceilf(radius) * 2 + 1;
+			first.resize(dst);
+			count.resize(dst);
+			weights.assign((size_t)dst * stride, 0.0f);
+
+			for (unsigned i = 0; i < dst; ++i)
+			{
+				float center = (i + 0.5f) / scale;
+				int begin = std::max((int)floorf(center - radius), 0);
+				int end = std::min((int)ceilf(center + radius), (int)src);
+				end = std::min(end, begin + (int)stride);
+
+				float * w = &weights[(size_t)i * stride];
+				float total = 0.0f;
+				for (int s = begin; s < end; ++s)
+				{
+					w[s - begin] = kernel((s + 0.5f - center) / stretch);
+					total += w[s - begin];
+				}
+
+				//Normalized, so flat areas stay flat at the edges too
+				if (total != 0.0f)
+					for (int s = begin; s < end; ++s)
+						w[s - begin] /= total;
+
+				first[i] = (unsigned)begin;
+				count[i] = (unsigned)(end - begin);
+			}
+		}
+	};
+
+	//Weighted sum of pixels, step apart
+	inline pixel convolve(const pixel * src, size_t step, const float * weights, unsigned count)
+	{
+		pixel result;
+#ifdef RESAMPLE_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned i = 0; i < count; ++i)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src[i * step].v), _mm_set1_ps(weights[i])));
+		_mm_storeu_ps(result.v, sum);
+#else
+		for (int ch = 0; ch < 4; ++ch)
+			result.v[ch] = 0.0f;
+		for (unsigned i = 0; i < count; ++i)
+			for (int ch = 0; ch < 4; ++ch)
+				result.v[ch] += src[i * step].v[ch] * weights[i];
+#endif
+		return result;
+	}
+
+	inline unsigned char to_byte(float value)
+	{
+		return (unsigned char)(value <= 0.0f ? 0 : (value >= 255.0f ? 255 : (int)(value + 0.5f)));
+	}
+}
+
+namespace img
+{
+	bool parse_filter(const std::string & name, resample_filter & filter)
+	{
+		if (name == "mitchell") filter = filter_mitchell;
+		else if (name == "lanczos") filter = filter_lanczos3;
+		else return false;
+
+		return true;
+	}
+
+	png * resample(const img & image, unsigned w, unsigned h, resample_filter filter)
+	{
+		png * result = new png(w, h);
+		unsigned sw = image.w(), sh = image.h();
+		if (w == 0 || h == 0 || sw == 0 || sh == 0) return result;
+
+		//Premultiply
+		std::vector<pixel> src((size_t)sw * sh);
+		const color * pixels = (const color *)image.data();
+		for (size_t i = 0; i < src.size(); ++i)
+		{
+			float a = pixels[i].a / 255.0f;
+			src[i].v[0] = pixels[i].r * a;
+			src[i].v[1] = pixels[i].g * a;
+			src[i].v[2] = pixels[i].b * a;
+			src[i].v[3] = pixels[i].a;
+		}
+
+		//Rows first, into a w x sh image, then columns
+		contributions columns(sw, w, filter);
+		std::vector<pixel> tmp((size_t)w * sh);
+		util::parallel_bands(sh, min_band_rows, [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y)
+				for (unsigned x = 0; x < w; ++x)
+					tmp[y * w + x] = convolve(&src[y * sw + columns.first[x]], 1, &columns.weights[(size_t)x * columns.stride], columns.count[x]);
+		});
+
+		contributions rows(sh, h, filter);
+		color * out = (color *)result->data();
+		util::parallel_bands(h, min_band_rows, [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y)
+			{
+				const float * weights = &rows.weights[y * rows.stride];
+				const pixel * column = &tmp[(size_t)rows.first[y] * w];
+				for (unsigned x = 0; x < w; ++x)
+				{
+					pixel p = convolve(column + x, w, weights, rows.count[y]);
+
+					//Unpremultiply
+					unsigned char a = to_byte(p.v[3]);
+					float scale = (p.v[3] > 0.0f) ? 255.0f / p.v[3] : 0.0f;
+					out[y * w + x] = color(to_byte(p.v[0] * scale), to_byte(p.v[1] * scale), to_byte(p.v[2] * scale), a);
+				}
+			}
+		});
+
+		return result;
+	}
+}
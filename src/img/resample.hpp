@@ -0,0 +1,43 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include "img.hpp"
+
+#include <string>
+
+namespace img
+{
+	//Resampling filters
+	enum resample_filter
+	{
+		//Mitchell-Netravali (B = C = 1/3), soft with little ringing
+		filter_mitchell,
+		//Lanczos with 3 lobes, sharper but may ring around hard edges
+		filter_lanczos3,
+	};
+
+	//Find a filter by its name ("mitchell", "lanczos"), false if unknown
+	bool parse_filter(const std::string & name, resample_filter & filter);
+
+	//Resize an image to w x h with a separable filter, rows are filtered in parallel
+	//Colors are filtered premultiplied by alpha, so transparent pixels don't bleed into the edges
+	png * resample(const img & image, unsigned w, unsigned h, resample_filter filter);
+}
@@ -0,0 +1,183 @@
+#include "slice.hpp"
+#include "png.hpp"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SLICE_SSE2 1
+#endif
+
+namespace
+{
+	inline uint32_t code_of(const img::color & c)
+	{
+		uint32_t code;
+		memcpy(&code, &c, sizeof(code));
+		return code;
+	}
+
+	//Are two rows of pixels the same
+	bool same_row(const img::color * a, const img::color * b, unsigned w)
+	{
+		unsigned x = 0;
+#ifdef SLICE_SSE2
+		__m128i diff = _mm_setzero_si128();
+		for (; x + 4 <= w; x += 4)
+			diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + x)), _mm_loadu_si128((const __m128i *)(b + x))));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+			return false;
+#endif
+		for (; x < w; ++x)
+			if (code_of(a[x]) != code_of(b[x]))
+				return false;
+		return true;
+	}
+
+	//Or the bits that differ between every pixel of a row and the one right of it into changes (w - 1 entries)
+	void column_changes(const img::color * row, unsigned w, uint32_t * changes)
+	{
+		unsigned x = 0;
+#ifdef SLICE_SSE2
+		for (; x + 4 < w; x += 4)
+		{
+			__m128i left = _mm_loadu_si128((const __m128i *)(row + x));
+			__m128i right = _mm_loadu_si128((const __m128i *)(row + x + 1));
+			__m128i acc = _mm_loadu_si128((const __m128i *)(changes + x));
+			_mm_storeu_si128((__m128i *)(changes + x), _mm_or_si128(acc, _mm_xor_si128(left, right)));
+		}
+#endif
+		for (; x + 1 < w; ++x)
+			changes[x] |= code_of(row[x]) ^ code_of(row[x + 1]);
+	}
+
+	//Does every column (row) differ from the next one, w - 1 (h - 1) flags
+	void find_changes(const img::img & image, std::vector<bool> & columns, std::vector<bool> & rows)
+	{
+		unsigned w = image.w(), h = image.h();
+		const img::color * pixels = (const img::color *)image.data();
+
+		std::vector<uint32_t> changes(std::max(w, 1u) - 1, 0);
+		for (unsigned y = 0; y < h; ++y)
+			column_changes(pixels + (size_t)y * w, w, changes.data());
+
+		columns.resize(changes.size());
+		for (size_t x = 0; x < changes.size(); ++x)
+			columns[x] = changes[x] != 0;
+
+		rows.resize(std::max(h, 1u) - 1);
+		for (unsigned y = 0; y + 1 < h; ++y)
+			rows[y] = !same_row(pixels + (size_t)y * w, pixels + (size_t)(y + 1) * w, w);
+	}
+
+	//Longest run of identical lines between first and last (exclusive), at least one line long unless empty
+	void longest_run(const std::vector<bool> & changes, unsigned first, unsigned last, unsigned & start, unsigned & length)
+	{
+		start = first;
+		length = (last > first) ? 1 : 0;
+		for (unsigned i = first; i < last;)
+		{
+			unsigned begin = i;
+			while (i + 1 < last && !changes[i]) ++i;
+			if (++i - begin > length)
+			{
+				start = begin;
+				length = i - begin;
+			}
+		}
+	}
+
+	//Are all lines between first and last (exclusive) the same, and is there more than one
+	bool uniform(const std::vector<bool> & changes, unsigned first, unsigned last)
+	{
+		if (last < first + 2) return false;
+		for (unsigned i = first; i + 1 < last; ++i)
+			if (changes[i])
+				return false;
+		return true;
+	}
+}
+
+namespace img
+{
+	insets find_insets(const img & image)
+	{
+		std::vector<bool> columns, rows;
+		find_changes(image, columns, rows);
+
+		//The whole length is the middle if no two lines are the same
+		insets result = { 0, 0, 0, 0 };
+		unsigned start, length;
+		longest_run(columns, 0, image.w(), start, length);
+		if (length > 1)
+		{
+			result.left = start;
+			result.right = image.w() - start - length;
+		}
+		longest_run(rows, 0, image.h(), start, length);
+		if (length > 1)
+		{
+			result.top = start;
+			result.bottom = image.h() - start - length;
+		}
+
+		return result;
+	}
+
+	png * compact_slices(const img & image, insets & borders)
+	{
+		unsigned w = image.w(), h = image.h();
+		borders.left = std::min(borders.left, w);
+		borders.right = std::min(borders.right, w - borders.left);
+		borders.top = std::min(borders.top, h);
+		borders.bottom = std::min(borders.bottom, h - borders.top);
+
+		std::vector<bool> columns, rows;
+		find_changes(image, columns, rows);
+
+		//A middle is only cut down if every line of it is the same, anything else would stretch differently
+		bool cut_x = (w - borders.left - borders.right > middle_lines) && uniform(columns, borders.left, w - borders.right);
+		bool cut_y = (h - borders.top - borders.bottom > middle_lines) && uniform(rows, borders.top, h - borders.bottom);
+
+		std::vector<unsigned> xs, ys;
+		for (unsigned x = 0; x < w; ++x)
+			if (!cut_x || x < borders.left + middle_lines || x >= w - borders.right)
+				xs.push_back(x);
+		for (unsigned y = 0; y < h; ++y)
+			if (!cut_y || y < borders.top + middle_lines || y >= h - borders.bottom)
+				ys.push_back(y);
+
+		const color * pixels = (const color *)image.data();
+		png * result = new png((unsigned)xs.size(), (unsigned)ys.size());
+		color * dst = (color *)result->data();
+		for (auto y : ys)
+		{
+			const color * row = pixels + (size_t)y * w;
+			if (!cut_x)
+			{
+				memcpy(dst, row, w * sizeof(color));
+				dst += w;
+				continue;
+			}
+
+			for (auto x : xs)
+				*dst++ = row[x];
+		}
+
+		//Only the centre line is stretched
+		if (cut_x)
+		{
+			++borders.left;
+			++borders.right;
+		}
+		if (cut_y)
+		{
+			++borders.top;
+			++borders.bottom;
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,46 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "img.hpp"
+
+namespace img
+{
+	//Lines a uniform nine-slice middle is cut down to, the borders get the outer ones
+	//The stretched centre line then only ever gets filtered with copies of itself
+	const unsigned middle_lines = 3;
+
+	//Border widths of a nine-slice sprite, the part between them is stretched
+	struct insets
+	{
+		unsigned left;
+		unsigned top;
+		unsigned right;
+		unsigned bottom;
+	};
+
+	//Borders around the widest run of identical columns and the tallest run of identical rows
+	//An axis with no two identical neighbours gets no borders (its whole length is the middle)
+	insets find_insets(const img & image);
+	//Copy of an image with its middle columns (rows) cut down to three if they're all the same, kept whole otherwise
+	//Borders are clamped to the image and set for the copy, a cut middle is its centre line
+	png * compact_slices(const img & image, insets & borders);
+}
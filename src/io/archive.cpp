@@ -0,0 +1,317 @@
+#include "archive.hpp"
+#include "io_internal.hpp"
+
+#include <zlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	const uint32_t zip_end_signature = 0x06054b50;
+	const uint32_t zip_central_signature = 0x02014b50;
+	const uint32_t zip_local_signature = 0x04034b50;
+	const size_t zip_end_size = 22;
+	const size_t zip_central_size = 46;
+	const size_t zip_local_size = 30;
+	const size_t zip_max_comment = 0xFFFF;
+
+	const size_t pak_header_size = 12;
+	const size_t pak_entry_size = 64;
+	const size_t pak_name_size = 56;
+
+	inline uint16_t get16(const unsigned char * ptr)
+	{ return (uint16_t)(ptr[0] | (ptr[1] << 8)); }
+
+	inline uint32_t get32(const unsigned char * ptr)
+	{ return (uint32_t)(ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24)); }
+
+	//Use forward slashes and no leading "./" in entry names
+	std::string normalize(std::string name)
+	{
+		for (auto & c : name)
+			if (c == '\\') c = '/';
+
+		while (name.compare(0, 2, "./") == 0)
+			name.erase(0, 2);
+
+		return (name);
+	}
+
+	bool has_archive_ext(const std::string & path)
+	{
+		if (path.size() < 4) return false;
+		std::string ext = path.substr(path.size() - 4);
+		for (auto & c : ext) c = (char)tolower(c);
+		return (ext == ".zip" || ext == ".pak");
+	}
+}
+
+namespace core
+{
+	archive::archive()
+		: _type(zip)
+	{ }
+
+	bool archive::open(const std::string & fname)
+	{
+		_entries.clear();
+		if (!_reader.open(fname, true))
+			return false;
+
+		char magic[4] = { 0 };
+		_reader.read(magic, 1, 4);
+		_reader.seek(0, io::start);
+
+		bool indexed = false;
+		if (memcmp(magic, "PACK", 4) == 0)
+		{
+			_type = pak;
+			indexed = index_pak();
+		}
+		else
+		{
+			_type = zip;
+			indexed = index_zip();
+		}
+
+		if (!indexed)
+		{
+			printf("[ARC] Can't index '%s'\n", fname.c_str());
+			_reader.close();
+			_entries.clear();
+		}
+
+		return indexed;
+	}
+
+	bool archive::opened() const
+	{ return _reader.opened(); }
+
+	bool archive::contains(const std::string & name) const
+	{ return (_entries.find(normalize(name)) != _entries.end()); }
+
+	///////////////////////////////////////////////////////////////
+
+	bool archive::index_zip()
+	{
+		_reader.seek(0, io::end);
+		long filesize = _reader.pos();
+		if (filesize < (long)zip_end_size)
+			return false;
+
+		//The end of central directory record is followed only by the comment
+		long tailsize = (long)std::min<size_t>(filesize, zip_end_size + zip_max_comment);
+		std::vector<unsigned char> tail(tailsize);
+		_reader.seek(filesize - tailsize, io::start);
+		if (_reader.read(tail.data(), 1, tailsize) != (size_t)tailsize)
+			return false;
+
+		const unsigned char * end = nullptr;
+		for (long i = tailsize - (long)zip_end_size; i >= 0; --i)
+		{
+			if (get32(&tail[i]) == zip_end_signature)
+			{
+				end = &tail[i];
+				break;
+			}
+		}
+
+		if (end == nullptr) return false;
+
+		uint16_t count = get16(end + 10);
+		uint32_t cdsize = get32(end + 12);
+		uint32_t cdoffset = get32(end + 16);
+		if (cdoffset == 0xFFFFFFFF || (long)cdoffset + (long)cdsize > filesize)
+		{
+			printf("[ARC] Zip64 archives aren't supported\n");
+			return false;
+		}
+
+		//Read the whole central directory at once
+		std::vector<unsigned char> directory(cdsize);
+		_reader.seek(cdoffset, io::start);
+		if (_reader.read(directory.data(), 1, cdsize) != cdsize)
+			return false;
+
+		_entries.reserve(count);
+		size_t pos = 0;
+		for (uint16_t i = 0; i < count; ++i)
+		{
+			if (pos + zip_central_size > directory.size()) return false;
+			const unsigned char * header = &directory[pos];
+			if (get32(header) != zip_central_signature) return false;
+
+			uint16_t flags = get16(header + 8);
+			entry ent;
+			ent.method = get16(header + 10);
+			ent.packed = get32(header + 20);
+			ent.size = get32(header + 24);
+			ent.offset = get32(header + 42);
+			uint16_t namelen = get16(header + 28);
+			uint16_t extralen = get16(header + 30);
+			uint16_t commentlen = get16(header + 32);
+
+			if (pos + zip_central_size + namelen > directory.size()) return false;
+			std::string name((const char*)header + zip_central_size, namelen);
+			pos += zip_central_size + namelen + extralen + commentlen;
+
+			//Skip directories and entries we can't read
+			if (name.empty() || name.back() == '/') continue;
+			if (flags & 0x1) continue; //encrypted
+			if (ent.method != 0 && ent.method != Z_DEFLATED) continue;
+			if ((uint64_t)ent.offset + ent.packed > (uint64_t)filesize) continue;
+
+			_entries[normalize(name)] = ent;
+		}
+
+		return true;
+	}
+
+	bool archive::index_pak()
+	{
+		_reader.seek(0, io::end);
+		long filesize = _reader.pos();
+		_reader.seek(0, io::start);
+
+		unsigned char header[pak_header_size];
+		if (_reader.read(header, 1, pak_header_size) != pak_header_size)
+			return false;
+
+		//Sizes come from the file, so they're checked before anything is allocated for them
+		uint32_t diroffset = get32(header + 4);
+		uint32_t dirsize = get32(header + 8);
+		if ((uint64_t)diroffset + dirsize > (uint64_t)filesize)
+			return false;
+		size_t count = dirsize / pak_entry_size;
+
+		std::vector<unsigned char> directory(dirsize);
+		_reader.seek(diroffset, io::start);
+		if (_reader.read(directory.data(), 1, dirsize) != dirsize)
+			return false;
+
+		_entries.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned char * ptr = &directory[i * pak_entry_size];
+			std::string name((const char*)ptr, strnlen((const char*)ptr, pak_name_size));
+
+			entry ent;
+			ent.offset = get32(ptr + pak_name_size);
+			ent.size = get32(ptr + pak_name_size + 4);
+			ent.packed = ent.size;
+			ent.method = 0;
+			if ((uint64_t)ent.offset + ent.size > (uint64_t)filesize)
+			{
+				printf("[ARC] Entry '%s' lies past the end of the archive\n", name.c_str());
+				continue;
+			}
+
+			if (!name.empty())
+				_entries[normalize(name)] = ent;
+		}
+
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////
+
+	bool archive::extract(const std::string & name, std::vector<unsigned char> & output)
+	{
+		auto it = _entries.find(normalize(name));
+		if (it == _entries.end())
+			return false;
+
+		const entry & ent = it->second;
+		std::vector<unsigned char> packed(ent.packed);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			uint32_t offset = ent.offset;
+			if (_type == zip)
+			{
+				//Data follows the local header, whose extra field may differ from the central one
+				unsigned char local[zip_local_size];
+				_reader.seek(offset, io::start);
+				if (_reader.read(local, 1, zip_local_size) != zip_local_size) return false;
+				if (get32(local) != zip_local_signature) return false;
+				offset += (uint32_t)zip_local_size + get16(local + 26) + get16(local + 28);
+			}
+
+			_reader.seek(offset, io::start);
+			if (_reader.read(packed.data(), 1, ent.packed) != ent.packed)
+				return false;
+		}
+
+		if (ent.method == 0)
+		{
+			output.swap(packed);
+			return true;
+		}
+
+		//Raw deflate stream (no zlib header)
+		output.resize(ent.size);
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+			return false;
+
+		stream.next_in = packed.data();
+		stream.avail_in = ent.packed;
+		stream.next_out = output.data();
+		stream.avail_out = ent.size;
+		int res = inflate(&stream, Z_FINISH);
+		inflateEnd(&stream);
+
+		if (res != Z_STREAM_END || stream.total_out != ent.size)
+		{
+			printf("[ARC] Can't inflate '%s'\n", name.c_str());
+			output.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////
+
+	archive * archive::get(const std::string & fname)
+	{
+		static std::mutex mutex;
+		static std::unordered_map<std::string, std::unique_ptr<archive>> archives;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = archives.find(fname);
+		if (it != archives.end())
+			return it->second->opened() ? it->second.get() : nullptr;
+
+		//Failed archives are remembered too, so they aren't reindexed for every entry
+		archive * arch = new archive();
+		archives[fname].reset(arch);
+		arch->open(fname);
+		return arch->opened() ? arch : nullptr;
+	}
+
+	bool archive::split(const std::string & path, std::string & archive_path, std::string & entry_name)
+	{
+		for (size_t i = 0; i < path.size(); ++i)
+		{
+			if (path[i] != '/' && path[i] != '\\')
+				continue;
+
+			std::string prefix = path.substr(0, i);
+			if (!has_archive_ext(prefix))
+				continue;
+
+			std::error_code error;
+			if (!fs::is_regular_file(prefix, error))
+				continue;
+
+			archive_path = prefix;
+			entry_name = normalize(path.substr(i + 1));
+			return true;
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "freader.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace core
+{
+	//A read-only zip or pak archive
+	//The entry index is built once when the archive is opened
+	class archive
+	{
+	public:
+		//Supported archive types
+		enum type
+		{
+			//Zip archive (stored or deflated entries)
+			zip,
+			//Quake style pak archive (stored entries only)
+			pak,
+		};
+
+		//An entry in the archive index
+		struct entry
+		{
+			//Offset of the local header (zip) or the data (pak)
+			uint32_t offset;
+			//Size of the stored data
+			uint32_t packed;
+			//Size of the extracted data
+			uint32_t size;
+			//Compression method (0 - stored, 8 - deflated)
+			uint16_t method;
+		};
+
+	private:
+		//Archive type
+		type _type;
+		//Archive file reader
+		freader _reader;
+		//Entry index (names use '/' as separator)
+		std::unordered_map<std::string, entry> _entries;
+		//Guards the reader when extracting
+		std::mutex _mutex;
+
+	public:
+		//Construct a closed archive
+		archive();
+		archive(const archive & other) = delete;
+		archive & operator = (const archive & other) = delete;
+
+		//Open an archive and build its index
+		bool open(const std::string & fname);
+		//Is an archive opened
+		bool opened() const;
+		//Archive type
+		inline type kind() const { return _type; }
+		//Number of entries in the index
+		inline size_t size() const { return _entries.size(); }
+
+		//Does the archive contain an entry
+		bool contains(const std::string & name) const;
+		//Extract the contents of an entry
+		bool extract(const std::string & name, std::vector<unsigned char> & output);
+
+		//Get an opened archive (opened and indexed on first use)
+		static archive * get(const std::string & fname);
+		//Split a path into archive and entry parts (eg. "art/ui.zip/button.png")
+		static bool split(const std::string & path, std::string & archive_path, std::string & entry_name);
+
+	private:
+		//Build the index from a zip central directory
+		bool index_zip();
+		//Build the index from a pak directory
+		bool index_pak();
+	};
+}
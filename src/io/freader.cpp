@@ -1,6 +1,7 @@
 #include "freader.hpp"
 
 #include <varargs.h>
+#include <string.h>
 
 namespace core
 {
@@ -8,17 +9,33 @@ namespace core
 	{ return (a < b ? a : b); }
 
 	freader::freader()
-		: _handle(nullptr)
+		: _binary(false)
+		, _handle(nullptr)
+		, _inmemory(false)
+		, _memeof(false)
+		, _mempos(0)
 	{ }
 
 	freader::freader(const std::string & fname)
-		: _handle(nullptr)
+		: freader()
 	{ open(fname, false); }
 
 	freader::freader(const std::string & fname, bool binary)
-		: _handle(nullptr)
+		: freader()
 	{ open(fname, binary); }
 
+	freader::freader(freader && other)
+		: _binary(other._binary)
+		, _handle(other._handle)
+		, _inmemory(other._inmemory)
+		, _memeof(other._memeof)
+		, _memory(std::move(other._memory))
+		, _mempos(other._mempos)
+	{
+		other._handle = nullptr;
+		other._inmemory = false;
+	}
+
 	freader::~freader()
 	{ close(); }
 
@@ -29,39 +46,85 @@ namespace core
 		//Create the open mode string
 		char mode[3] = { "rt" };
 		if (binary) mode[1] = 'b';
-		_binary = binary;
 		
 		close();
+		_binary = binary;
 		_handle = fopen(fname.c_str(), mode);
 		
 		return ok();
 	}
 
+	bool freader::open(std::vector<unsigned char> && content)
+	{
+		close();
+		_binary = true;
+		_inmemory = true;
+		_memeof = false;
+		_memory = std::move(content);
+		_mempos = 0;
+
+		return ok();
+	}
+
 	bool freader::opened() const
-	{ return (_handle != nullptr); }
+	{ return (_handle != nullptr || _inmemory); }
 
 	void freader::close()
 	{
 		if (!opened()) return;
 		_binary = false;
+		if (_inmemory)
+		{
+			_inmemory = false;
+			_memory.clear();
+			_memory.shrink_to_fit();
+			return;
+		}
+
 		fclose(_handle);
+		_handle = nullptr;
 	}
 
 	///////////////////////////////////////////////////////////////
 
 	bool freader::ok() const
-	{ return (opened() && ferror(_handle) == 0); }
+	{
+		if (_inmemory) return true;
+		return (opened() && ferror(_handle) == 0);
+	}
 
 	bool freader::eof() const
-	{ return (feof(_handle) != 0); }
+	{
+		if (_inmemory) return _memeof;
+		return (feof(_handle) != 0);
+	}
 
 	///////////////////////////////////////////////////////////////
 
 	long freader::pos() const
-	{ return (ftell(_handle)); }
+	{
+		if (_inmemory) return (long)_mempos;
+		return (ftell(_handle));
+	}
 
 	void freader::seek(long offset, io::seekdir dir)
-	{ fseek(_handle, offset, (int)dir); }
+	{
+		if (!_inmemory)
+		{
+			fseek(_handle, offset, (int)dir);
+			return;
+		}
+
+		long base = 0;
+		if (dir == io::current) base = (long)_mempos;
+		else if (dir == io::end) base = (long)_memory.size();
+
+		long target = base + offset;
+		if (target < 0) target = 0;
+		if (target > (long)_memory.size()) target = (long)_memory.size();
+		_mempos = (size_t)target;
+		_memeof = false;
+	}
 
 	///////////////////////////////////////////////////////////////
 
@@ -109,7 +172,17 @@ namespace core
 
 	size_t freader::read(void * ptr, size_t elem_size, size_t elem_count)
 	{
-		return (fread(ptr, elem_size, elem_count, _handle));
+		if (!_inmemory)
+			return (fread(ptr, elem_size, elem_count, _handle));
+
+		if (elem_size == 0) return 0;
+		size_t available = (_memory.size() - _mempos) / elem_size;
+		size_t count = min(elem_count, available);
+		if (count < elem_count) _memeof = true;
+
+		memcpy(ptr, _memory.data() + _mempos, count * elem_size);
+		_mempos += count * elem_size;
+		return (count);
 	}
 
 	///////////////////////////////////////////////////////////////
@@ -26,6 +26,7 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 #include <stdio.h>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace core
 {
@@ -36,6 +37,15 @@ namespace core
 		//Internal file handle
 		FILE * _handle;
 
+		//Whether reading from memory instead of a file
+		bool _inmemory;
+		//Whether a read went past the end of the memory
+		bool _memeof;
+		//Memory contents (when reading from memory)
+		std::vector<unsigned char> _memory;
+		//Memory marker position
+		size_t _mempos;
+
 	public:
 		//Construct a file reader
 		freader();
@@ -43,10 +53,17 @@ namespace core
 		freader(const std::string & fname);
 		//Construct a file reader
 		freader(const std::string & fname, bool binary);
+		//Move construct a file reader
+		freader(freader && other);
+		freader(const freader & other) = delete;
 		~freader();
 
+		freader & operator = (const freader & other) = delete;
+
 		//Open another file (auto closes)
 		bool open(const std::string & fname, bool binary);
+		//Read from a memory buffer instead of a file (auto closes)
+		bool open(std::vector<unsigned char> && content);
 		//Is a file opened
 		bool opened() const;
 		//Close the file
@@ -1,32 +1,190 @@
 #include "fwriter.hpp"
 
 #include <assert.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	const uint64_t fnv_offset = 14695981039346656037ULL;
+	const uint64_t fnv_prime = 1099511628211ULL;
+
+	//64-bit FNV-1a
+	uint64_t hash_bytes(uint64_t hash, const char * data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= fnv_prime;
+		}
+
+		return (hash);
+	}
+
+	//Check if a file's contents hash the same
+	bool same_contents(const std::string & fname, uint64_t size, uint64_t hash)
+	{
+		std::error_code error;
+		if (core::fs::file_size(fname, error) != size || error)
+			return false;
+
+		FILE * file = fopen(fname.c_str(), "rb");
+		if (file == nullptr)
+			return false;
+
+		std::vector<char> chunk(core::fwriter::buffer_size);
+		uint64_t existing = fnv_offset;
+		size_t count;
+		while ((count = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+			existing = hash_bytes(existing, chunk.data(), count);
+
+		bool failed = (ferror(file) != 0);
+		fclose(file);
+		return (!failed && existing == hash);
+	}
+}
 
 namespace core
 {
+	//Writes full buffers on a separate thread, while the owner fills the next one
+	class fwriter::flusher
+	{
+		std::thread _thread;
+		std::mutex _mutex;
+		std::condition_variable _cond;
+		std::vector<char> _pending;
+		FILE * _handle;
+		bool _busy;
+		bool _quit;
+		bool _failed;
+
+	public:
+		flusher(FILE * handle)
+			: _handle(handle)
+			, _busy(false)
+			, _quit(false)
+			, _failed(false)
+		{
+			_pending.reserve(buffer_size);
+			_thread = std::thread([this]() { run(); });
+		}
+
+		~flusher()
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_quit = true;
+			}
+
+			_cond.notify_all();
+			_thread.join();
+		}
+
+		//Hand a buffer to the thread (swaps in an empty one)
+		void push(std::vector<char> & buffer)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cond.wait(lock, [this]() { return !_busy; });
+			_pending.swap(buffer);
+			buffer.clear();
+			_busy = true;
+			_cond.notify_all();
+		}
+
+		//Wait until everything handed over is written
+		bool wait()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cond.wait(lock, [this]() { return !_busy; });
+			return !_failed;
+		}
+
+	private:
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (true)
+			{
+				_cond.wait(lock, [this]() { return _busy || _quit; });
+				if (!_busy) return;
+
+				//The owner doesn't touch the pending buffer while busy
+				lock.unlock();
+				size_t written = fwrite(_pending.data(), 1, _pending.size(), _handle);
+				bool failed = (written != _pending.size());
+				lock.lock();
+
+				_failed = _failed || failed;
+				_busy = false;
+				_cond.notify_all();
+			}
+		}
+	};
+
+	///////////////////////////////////////////////////////////////
+
 	fwriter::fwriter()
-		: _handle(nullptr)
+		: _binary(false)
+		, _handle(nullptr)
+		, _hash(fnv_offset)
+		, _written(0)
+		, _hashed(true)
+		, _failed(false)
+		, _unchanged(false)
+		, _exceptions(std::uncaught_exceptions())
 	{ }
 	
 	fwriter::fwriter(const std::string & fname)
-		: _handle(nullptr)
+		: fwriter()
 	{ open(fname, false, false); }
 
 	fwriter::fwriter(const std::string & fname, bool binary)
-		: _handle(nullptr)
+		: fwriter()
 	{ open(fname, binary, false); }
 
 	fwriter::fwriter(const std::string & fname, bool binary, bool append)
-		: _handle(nullptr)
+		: fwriter()
 	{ open(fname, binary, append); }
 
+	fwriter::fwriter(fwriter && other)
+		: _binary(other._binary)
+		, _handle(other._handle)
+		, _fname(std::move(other._fname))
+		, _tmpname(std::move(other._tmpname))
+		, _buffer(std::move(other._buffer))
+		, _flusher(std::move(other._flusher))
+		, _hash(other._hash)
+		, _written(other._written)
+		, _hashed(other._hashed)
+		, _failed(other._failed)
+		, _unchanged(other._unchanged)
+		, _exceptions(std::uncaught_exceptions())
+	{
+		other._handle = nullptr;
+	}
+
 	fwriter::~fwriter()
-	{ close(); }
+	{
+		//Don't replace the target with a half-written file when unwinding
+		if (std::uncaught_exceptions() > _exceptions) discard();
+		else close();
+	}
 
 	///////////////////////////////////////////////////////////////
 	
 	FILE * fwriter::handle()
-	{ return _handle; }
+	{
+		//Anything written through the handle must come after the buffered data
+		//and isn't tracked by the hash
+		flush();
+		if (_flusher) _failed = !_flusher->wait() || _failed;
+		_flusher.reset();
+		_hashed = false;
+		return _handle;
+	}
 
 	const FILE * fwriter::handle() const
 	{ return _handle; }
@@ -34,13 +192,22 @@ namespace core
 	bool fwriter::open(const std::string & fname, bool binary, bool append)
 	{
 		//Create the open mode string
-		char mode[4] = { "wt\0" };
+		char mode[3] = { "wt" };
+		if (append) mode[0] = 'a';
 		if (binary) mode[1] = 'b';
-		if (append) mode[2] = '+';
-		_binary = binary;
 
 		close();
-		_handle = fopen(fname.c_str(), mode);
+		_binary = binary;
+		_fname = fname;
+		_tmpname = append ? "" : (fname + ".tmp");
+		_hash = fnv_offset;
+		_written = 0;
+		_hashed = !append;
+		_failed = false;
+		_unchanged = false;
+		_buffer.reserve(buffer_size);
+
+		_handle = fopen((append ? _fname : _tmpname).c_str(), mode);
 
 		return ok();
 	}
@@ -49,20 +216,115 @@ namespace core
 	{ return _handle != nullptr; }
 	
 	void fwriter::close()
-	{ if (opened()) fclose(_handle); }
+	{
+		if (!opened()) return;
+
+		flush();
+		if (_flusher) _failed = !_flusher->wait() || _failed;
+		_flusher.reset();
+		_failed = (fclose(_handle) != 0) || _failed;
+		_handle = nullptr;
+		_buffer.clear();
+
+		if (_tmpname.empty())
+			return;
+
+		std::error_code error;
+		if (_failed)
+		{
+			//Keep the old file rather than a broken one
+			printf("[IO] Failed writing '%s'\n", _fname.c_str());
+			fs::remove(_tmpname, error);
+		}
+		else if (_binary && _hashed && same_contents(_fname, _written, _hash))
+		{
+			_unchanged = true;
+			fs::remove(_tmpname, error);
+		}
+		else
+		{
+			fs::rename(_tmpname, _fname, error);
+			if (error)
+			{
+				//Some platforms don't replace existing files on rename
+				fs::remove(_fname, error);
+				fs::rename(_tmpname, _fname, error);
+			}
+		}
+
+		_tmpname.clear();
+	}
+
+	void fwriter::discard()
+	{
+		if (!opened()) return;
+
+		_buffer.clear();
+		_flusher.reset();
+		fclose(_handle);
+		_handle = nullptr;
+
+		if (!_tmpname.empty())
+		{
+			std::error_code error;
+			fs::remove(_tmpname, error);
+			_tmpname.clear();
+		}
+	}
+
+	///////////////////////////////////////////////////////////////
+
+	void fwriter::async(bool enable)
+	{
+		if (enable == async() || !opened()) return;
+		//Only sequential writes are flushed in the background
+		if (enable && !_hashed) return;
+
+		flush();
+		if (enable) _flusher.reset(new flusher(_handle));
+		else _flusher.reset();
+	}
+
+	bool fwriter::async() const
+	{ return (bool)_flusher; }
+
+	void fwriter::flush()
+	{
+		if (!opened() || _buffer.empty()) return;
+
+		if (_flusher)
+		{
+			_flusher->push(_buffer);
+			return;
+		}
+
+		if (fwrite(_buffer.data(), 1, _buffer.size(), _handle) != _buffer.size())
+			_failed = true;
+
+		_buffer.clear();
+	}
 
 	///////////////////////////////////////////////////////////////
 	
 	bool fwriter::ok() const
-	{ return opened() && ferror(_handle) == 0; }
+	{ return opened() && !_failed && ferror(_handle) == 0; }
+
+	bool fwriter::unchanged() const
+	{ return _unchanged; }
 
 	///////////////////////////////////////////////////////////////
 	
 	long fwriter::pos() const
-	{ return ftell(_handle); }
+	{
+		//Sequential writes may still be pending on the flushing thread
+		if (_hashed) return (long)_written;
+		return ftell(_handle) + (long)_buffer.size();
+	}
 	
 	void fwriter::seek(long offset, io::seekdir dir)
-	{ fseek(_handle, offset, (int)dir); }
+	{
+		fseek(handle(), offset, (int)dir);
+	}
 
 	///////////////////////////////////////////////////////////////
 
@@ -85,7 +347,25 @@ namespace core
 
 	size_t fwriter::write(void * ptr, size_t elem_size, size_t elem_count)
 	{
-		return fwrite(ptr, elem_size, elem_count, _handle);
+		if (!opened()) return 0;
+
+		const char * data = (const char*)ptr;
+		size_t size = elem_size * elem_count;
+		_hash = hash_bytes(_hash, data, size);
+		_written += size;
+
+		while (size > 0)
+		{
+			if (_buffer.size() == buffer_size)
+				flush();
+
+			size_t chunk = std::min(size, buffer_size - _buffer.size());
+			_buffer.insert(_buffer.end(), data, data + chunk);
+			data += chunk;
+			size -= chunk;
+		}
+
+		return elem_count;
 	}
 
 	void fwriter::writeline()
@@ -24,17 +24,49 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 
 #include <stdio.h>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace core
 {
+	//Writes are collected in a large buffer and go to a temporary file, which replaces
+	//the target on close() - readers never see a half-written file. If the new contents
+	//are the same as the existing file's, the existing file is left untouched.
+	//Append mode writes straight to the target.
 	class fwriter
 	{
-		//Internal file handle
+		class flusher;
+
+		//Whether writing in binary mode
 		bool _binary;
+		//Internal file handle
 		FILE * _handle;
+		//Target file name
+		std::string _fname;
+		//Temporary file name (empty when writing straight to the target)
+		std::string _tmpname;
+		//Buffered data
+		std::vector<char> _buffer;
+		//Background flushing thread (when async)
+		std::unique_ptr<flusher> _flusher;
+		//Running hash of everything written
+		uint64_t _hash;
+		//Number of bytes written
+		uint64_t _written;
+		//Whether the hash still describes the file (no seeking happened)
+		bool _hashed;
+		//Whether a write failed
+		bool _failed;
+		//Whether the last close() kept the existing file
+		bool _unchanged;
+		//Exceptions in flight when constructed, more in the destructor means it runs while unwinding
+		int _exceptions;
 
 	public:
+		//Size of the write buffer
+		static const size_t buffer_size = 1 << 20;
+
 		//Construct a file reader
 		fwriter();
 		//Construct a file reader
@@ -43,9 +75,14 @@ namespace core
 		fwriter(const std::string & fname, bool binary);
 		//Construct a file reader
 		fwriter(const std::string & fname, bool binary, bool append);
+		//Move construct a file writer
+		fwriter(fwriter && other);
+		fwriter(const fwriter & other) = delete;
 		~fwriter();
 
-		//Get native handle
+		fwriter & operator = (const fwriter & other) = delete;
+
+		//Get native handle (flushes the buffer, turns async and unchanged checks off)
 		FILE * handle();
 		//Get native handle
 		const FILE * handle() const;
@@ -53,11 +90,22 @@ namespace core
 		bool open(const std::string & fname, bool binary, bool append);
 		//Is a file opened
 		bool opened() const;
-		//Close the file
+		//Close the file and replace the target with it
 		void close();
+		//Close the file and throw away everything written
+		void discard();
+
+		//Flush full buffers on a background thread (sequential writes only, seeking turns it off)
+		void async(bool enable);
+		//Are full buffers flushed on a background thread
+		bool async() const;
+		//Write the buffered data to the file
+		void flush();
 
 		//Is the file write OK
 		bool ok() const;
+		//Did the last close() keep the existing file (same contents)
+		bool unchanged() const;
 
 		//Get the current marker position
 		long pos() const;
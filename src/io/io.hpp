@@ -23,4 +23,5 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 
 #include "io_internal.hpp"
 #include "freader.hpp"
-#include "fwriter.hpp"
\ No newline at end of file
+#include "fwriter.hpp"
+#include "archive.hpp"
\ No newline at end of file
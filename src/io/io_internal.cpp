@@ -1,6 +1,7 @@
 #include "io_internal.hpp"
 #include "freader.hpp"
 #include "fwriter.hpp"
+#include "archive.hpp"
 #include <sys/stat.h>
 
 namespace
@@ -19,6 +20,18 @@ namespace core
 	{
 		freader read(const std::string & fname, bool binary)
 		{
+			std::string archive_path, entry_name;
+			if (archive::split(fname, archive_path, entry_name))
+			{
+				freader reader;
+				std::vector<unsigned char> content;
+				archive * arch = archive::get(archive_path);
+				if (arch != nullptr && arch->extract(entry_name, content))
+					reader.open(std::move(content));
+
+				return (reader);
+			}
+
 			return (freader(fname, binary));
 		}
 
@@ -139,6 +152,18 @@ namespace core
 			return 0;
 		}
 
+		bool exists(const std::string & path)
+		{
+			std::string archive_path, entry_name;
+			if (archive::split(path, archive_path, entry_name))
+			{
+				archive * arch = archive::get(archive_path);
+				return (arch != nullptr && arch->contains(entry_name));
+			}
+
+			return (fs::exists(path));
+		}
+
 		////////////////////////////////////////////////////////////////////////////////
 
 		time_t atime(const std::string & path)
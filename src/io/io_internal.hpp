@@ -41,7 +41,7 @@ namespace core
 			end = SEEK_END,
 		};
 
-		//Read a file
+		//Read a file (paths inside .zip/.pak archives are read from the archive)
 		freader read(const std::string & fname, bool binary = false);
 		//Write to a file
 		fwriter write(const std::string & fname, bool binary = false, bool append = false);
@@ -61,6 +61,9 @@ namespace core
 		//Append the contents of a file to another file
 		bool append_content(const std::string & from, fwriter & to);
 
+		//Does a file (or an entry inside a .zip/.pak archive) exist
+		bool exists(const std::string & path);
+
 		//Last access time to the file
 		time_t atime(const std::string & path);
 		//Last modification time to the file
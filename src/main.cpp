@@ -24,6 +24,9 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 #include <json/reader.h>
 
 #include "texture_packer.hpp"
+#include "options.hpp"
+
+#include <algorithm>
 
 using namespace core;
 
@@ -51,7 +54,106 @@ std::vector<core::fs::path> spritesheet_list(const fs::path & directory)
 	return result;
 }
 
-void process_atlas(const fs::path & settings_path, const fs::path & outdir)
+//Apply a sheet's "Options" object over the command line options
+//Members are named like the command line options: { "pixel-format": "RGBA4444", "header": true, "index": ["plist", "bin"] }
+//false turns a flag off ("--no-<name>")
+bool sheet_options(const json::value & json, options & opts)
+{
+	//Strings as they are, numbers as on the command line
+	auto text = [](const json::value & value)
+	{
+		if (!value.is_numeric()) return value.as_string();
+		return value.is_integral() ? std::to_string(value.as_int()) : std::to_string(value.as_double());
+	};
+
+	for (auto & name : json.get_member_names())
+	{
+		const json::value & value = json[name];
+		std::string arg = "--" + name;
+
+		if (value.is_bool())
+		{
+			if (!value.as_bool()) arg = "--no-" + name;
+		}
+		else if (value.is_string() || value.is_numeric())
+		{
+			arg += "=" + text(value);
+		}
+		else if (value.is_array())
+		{
+			arg += "=";
+			for (json::array_index i = 0; i < value.size(); ++i)
+				arg += (i > 0 ? "," : "") + text(value[i]);
+		}
+
+		if (!opts.parse(arg))
+		{
+			printf("[TEX] Unknown or invalid sheet option '%s'\n", name.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Pack and save one sheet, out is the output path without an extension
+void pack_sheet(const std::vector<sprite> & sprites, const fs::path & base_dir, const fs::path & out, const options & opts, std::shared_ptr<sprite_images> images)
+{
+	texture_packer packer(true, base_dir.string(), opts, images);
+	for (auto & spr : sprites)
+		packer.add(spr);
+
+	//Packs on save
+	std::string texture = out.string();
+	std::string index = out.string();
+	packer.save(texture, index);
+}
+
+//Pack a sheet at all the resolutions of its options, out is the output path without an extension
+void pack_resolutions(const std::vector<sprite> & sprites, const fs::path & base_dir, const fs::path & out, const options & opts, std::shared_ptr<sprite_images> images)
+{
+	if (opts.resolutions.empty())
+	{
+		pack_sheet(sprites, base_dir, out, opts, images);
+		return;
+	}
+
+	unsigned source = *std::max_element(opts.resolutions.begin(), opts.resolutions.end());
+	for (auto resolution : opts.resolutions)
+	{
+		options res_opts = opts;
+		res_opts.scale *= (float)resolution / source;
+		fs::path res_out = out;
+		res_out += "@" + std::to_string(resolution) + "x";
+		pack_sheet(sprites, base_dir, res_out, res_opts, images);
+	}
+}
+
+//Read the output profiles of a sheet: { "<name>": { options... }, ... }
+//Every profile applies its options over the sheet's and is written to "<outdir>/<name>/"
+bool sheet_profiles(const json::value & json, const options & opts, std::vector<std::pair<std::string, options>> & profiles)
+{
+	if (json.type() != json::object_value)
+	{
+		printf("[TEX] Profiles must be an object of named options\n");
+		return false;
+	}
+
+	for (auto & name : json.get_member_names())
+	{
+		options profile_opts = opts;
+		if (!sheet_options(json[name], profile_opts))
+			return false;
+
+		//Profiles can't nest
+		profile_opts.profiles.clear();
+		profiles.push_back(std::make_pair(name, profile_opts));
+	}
+
+	return true;
+}
+
+void process_atlas(const fs::path & settings_path, const fs::path & outdir, const options & opts)
 {
 	std::string settings_content;
 	io::read_content(settings_path.string(), settings_content);
@@ -60,6 +162,39 @@ void process_atlas(const fs::path & settings_path, const fs::path & outdir)
 	json::value settings;
 	reader.parse(settings_content, settings, false);
 
+	//Either a plain list of sprites or { "Options": {...}, "Profiles": {...}, "Sprites": [...] }
+	options sheet_opts = opts;
+	json::value profiles_json;
+	if (settings.type() == json::object_value)
+	{
+		if (settings.is_member("Options") && !sheet_options(settings["Options"], sheet_opts))
+			return;
+		if (settings.is_member("Profiles"))
+			profiles_json = settings["Profiles"];
+
+		settings = json::value(settings["Sprites"]);
+	}
+
+	//Sheet profiles win over a profiles file
+	if (profiles_json.is_null() && !sheet_opts.profiles.empty())
+	{
+		std::string profiles_content;
+		io::read_content(sheet_opts.profiles, profiles_content);
+		if (!reader.parse(profiles_content, profiles_json, false))
+		{
+			printf("[TEX] Can't read profiles '%s'\n", sheet_opts.profiles.c_str());
+			return;
+		}
+	}
+
+	std::vector<std::pair<std::string, options>> profiles;
+	if (profiles_json.is_null()) profiles.push_back(std::make_pair(std::string(), sheet_opts));
+	else if (!sheet_profiles(profiles_json, sheet_opts, profiles)) return;
+
+	for (auto & profile : profiles)
+		if (!profile.second.check())
+			return;
+
 	if (settings.type() != json::array_value)
 	{
 		printf("[TEx] Can't process '%s' - incorrect settings", settings_path.string().c_str());
@@ -67,7 +202,7 @@ void process_atlas(const fs::path & settings_path, const fs::path & outdir)
 	}
 
 	printf("[TEX] Processing '%s' (%u sprites)\n", settings_path.stem().string().c_str(), settings.size());
-	texture_packer packer(true, settings_path.parent_path().string());
+	std::vector<sprite> sprites;
 	for (auto & cell : settings)
 	{
 		sprite spr;
@@ -77,17 +212,28 @@ void process_atlas(const fs::path & settings_path, const fs::path & outdir)
 		spr.offset.y = cell["Offset"]["Y"].as_int();
 		spr.scale.x = cell["Scale"]["X"].as_float();
 		spr.scale.y = cell["Scale"]["Y"].as_float();
-		packer.add(spr);
+		//"NineSlice": true finds the borders from the pixels, { "Left": 8, "Top": 8, "Right": 8, "Bottom": 8 } sets them
+		const json::value & slice = cell["NineSlice"];
+		spr.nine_slice = slice.is_object() || (slice.is_bool() && slice.as_bool());
+		if (slice.is_object())
+			spr.slice = { slice["Left"].as_uint(), slice["Top"].as_uint(), slice["Right"].as_uint(), slice["Bottom"].as_uint() };
+		sprites.push_back(spr);
 	}
-	
-	fs::path plist = outdir;
-	plist /= settings_path.stem();
 
-	fs::path outimg = outdir;
-	outimg /= settings_path.stem();
+	//Every profile and resolution is packed from the same decoded sprites
+	auto images = std::make_shared<sprite_images>();
+	std::string name = settings_path.stem().string();
+	for (auto & profile : profiles)
+	{
+		fs::path profile_dir = outdir / profile.first;
+		if (!profile.first.empty())
+		{
+			printf("[TEX] Profile '%s'\n", profile.first.c_str());
+			fs::create_directories(profile_dir);
+		}
 
-	packer.pack();
-	packer.save(outimg.string(), plist.string());
+		pack_resolutions(sprites, settings_path.parent_path(), profile_dir / name, profile.second, images);
+	}
 }
 
 void generate_sheet(const fs::path & input, const fs::path & outfile, int offx, int offy)
@@ -124,8 +270,9 @@ void generate_sheet(const fs::path & input, const fs::path & outfile, int offx,
 void usage()
 {
 	printf("Usage:\n");
-	printf("texpack -ps input/dir/ out/dir/\n");
+	printf("texpack -ps input/dir/ out/dir/ [options]\n");
 	printf("texpack -gs input/dir/ out/file.json xoffset yoffset\n");
+	options::usage();
 }
 
 int pmain(int argn, char ** args)
@@ -136,16 +283,27 @@ int pmain(int argn, char ** args)
 		return 1;
 	}
 
-	if (strcmp(args[1], "-ps") == 0 && argn == 4)
+	if (strcmp(args[1], "-ps") == 0 && argn >= 4)
 	{
 		fs::path graphics = args[2];
 		fs::path outdir = args[3];
 
+		options opts;
+		for (int i = 4; i < argn; ++i)
+		{
+			if (!opts.parse(args[i]))
+			{
+				printf("[TEX] Unknown or invalid option '%s'\n", args[i]);
+				usage();
+				return 1;
+			}
+		}
+
 		fs::path spritesheets_dir = graphics / "spritesheets";
 		auto sheets = spritesheet_list(spritesheets_dir);
 		printf("[TEX] Processing %u spritesheet(s)\n", sheets.size());
 		for (auto & sheet : sheets)
-			process_atlas(sheet, outdir);
+			process_atlas(sheet, outdir, opts);
 
 		return 0;
 	}
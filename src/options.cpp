@@ -0,0 +1,458 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "options.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+	//Split "--name=value" into its parts
+	bool split(const std::string & arg, std::string & name, std::string & value)
+	{
+		if (arg.compare(0, 2, "--") != 0)
+			return false;
+
+		size_t eq = arg.find('=');
+		name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+		value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+		return true;
+	}
+
+	//Parse a comma separated list of index formats
+	bool parse_index(const std::string & value, unsigned & result)
+	{
+		result = 0;
+		size_t start = 0;
+		while (start <= value.size())
+		{
+			size_t comma = value.find(',', start);
+			if (comma == std::string::npos) comma = value.size();
+			std::string name = value.substr(start, comma - start);
+			start = comma + 1;
+
+			if (name == "plist") result |= index_plist;
+			else if (name == "bin") result |= index_binary;
+			else return false;
+		}
+
+		return (result != 0);
+	}
+
+	//Parse a texture file format
+	bool parse_texture(const std::string & value, texture_format & result)
+	{
+		if (value == "png") result = texture_png;
+		else if (value == "pvr") result = texture_pvr;
+		else if (value == "pvr.ccz") result = texture_pvr_ccz;
+		else if (value == "dds") result = texture_dds;
+		else if (value == "ktx") result = texture_ktx;
+		else if (value == "pkm") result = texture_pkm;
+		else if (value == "astc") result = texture_astc;
+		else if (value == "raw") result = texture_raw;
+		else if (value == "qoi") result = texture_qoi;
+		else return false;
+
+		return true;
+	}
+
+	//Parse an alpha mask format ("" for a PNG)
+	bool parse_alpha_mask(const std::string & value, alpha_mask_format & result)
+	{
+		if (value.empty() || value == "png") result = alpha_mask_png;
+		else if (value == "zlib") result = alpha_mask_zlib;
+		else return false;
+
+		return true;
+	}
+
+	//Parse a block alignment ("" aligns to the pixel format)
+	bool parse_align(const std::string & value, unsigned & result)
+	{
+		if (value.empty())
+		{
+			result = block_align_format;
+			return true;
+		}
+
+		char * end = nullptr;
+		unsigned long n = strtoul(value.c_str(), &end, 10);
+		if (*end != '\0' || n < 1 || n > block_align_max)
+			return false;
+
+		result = (unsigned)n;
+		return true;
+	}
+
+	//Parse the mip level sprites stay apart down to ("" for the default)
+	bool parse_mipmaps(const std::string & value, unsigned & result)
+	{
+		if (value.empty())
+		{
+			result = mipmaps_default;
+			return true;
+		}
+
+		char * end = nullptr;
+		unsigned long n = strtoul(value.c_str(), &end, 10);
+		if (*end != '\0' || n < 1 || n > mipmaps_max)
+			return false;
+
+		result = (unsigned)n;
+		return true;
+	}
+
+	//Parse the most corners of sprite polygons ("" for the default)
+	bool parse_polygons(const std::string & value, unsigned & result)
+	{
+		if (value.empty())
+		{
+			result = polygon_vertices_default;
+			return true;
+		}
+
+		char * end = nullptr;
+		unsigned long n = strtoul(value.c_str(), &end, 10);
+		if (*end != '\0' || n < 3 || n > polygon_vertices_max)
+			return false;
+
+		result = (unsigned)n;
+		return true;
+	}
+
+	//Parse a texture size limit
+	bool parse_size(const std::string & value, unsigned & result)
+	{
+		char * end = nullptr;
+		unsigned long n = strtoul(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0' || n < 1 || n > 65536)
+			return false;
+
+		result = (unsigned)n;
+		return true;
+	}
+
+	//Parse a positive scale
+	bool parse_scale(const std::string & value, float & result)
+	{
+		char * end = nullptr;
+		double n = strtod(value.c_str(), &end);
+		if (value.empty() || *end != '\0' || !(n > 0.0) || n > 16.0)
+			return false;
+
+		result = (float)n;
+		return true;
+	}
+
+	//Parse a comma separated list of resolutions (eg. "1,2,4")
+	bool parse_resolutions(const std::string & value, std::vector<unsigned> & result)
+	{
+		result.clear();
+		size_t start = 0;
+		while (start <= value.size())
+		{
+			size_t comma = value.find(',', start);
+			if (comma == std::string::npos) comma = value.size();
+			std::string item = value.substr(start, comma - start);
+			start = comma + 1;
+
+			//"2x" reads as 2 too
+			if (!item.empty() && (item.back() == 'x' || item.back() == 'X'))
+				item.pop_back();
+
+			char * end = nullptr;
+			unsigned long n = strtoul(item.c_str(), &end, 10);
+			if (item.empty() || *end != '\0' || n < 1 || n > 16)
+				return false;
+			if (std::find(result.begin(), result.end(), (unsigned)n) == result.end())
+				result.push_back((unsigned)n);
+		}
+
+		return !result.empty();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+const char * texture_extension(texture_format format)
+{
+	switch (format)
+	{
+	case texture_pvr: return ".pvr";
+	case texture_pvr_ccz: return ".pvr.ccz";
+	case texture_dds: return ".dds";
+	case texture_ktx: return ".ktx";
+	case texture_pkm: return ".pkm";
+	case texture_astc: return ".astc";
+	case texture_raw: return ".raw";
+	case texture_qoi: return ".qoi";
+	default: return ".png";
+	}
+}
+
+bool texture_mipmaps(texture_format format)
+{
+	return (format == texture_pvr || format == texture_pvr_ccz || format == texture_dds || format == texture_ktx);
+}
+
+const char * alpha_mask_extension(alpha_mask_format format)
+{
+	switch (format)
+	{
+	case alpha_mask_png: return "@alpha.png";
+	case alpha_mask_zlib: return "@alpha.raw.z";
+	default: return "";
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+options::options()
+	: index(index_plist)
+	, header(false)
+	, texture(texture_png)
+	, pixel_format(img::rgba8888)
+	, dither(img::dither_none)
+	, quality(img::quality_normal)
+	, etc1_alpha(img::alpha_none)
+	, block_align(0)
+	, mipmaps(0)
+	, scale(1.0f)
+	, filter(img::filter_mitchell)
+	, max_size(0)
+	, premultiply_alpha(false)
+	, auto_format(false)
+	, channel_pack(false)
+	, split_alpha(false)
+	, jpeg_alpha(alpha_mask_none)
+	, png8(false)
+	, polygons(0)
+{ }
+
+bool options::parse(const std::string & arg)
+{
+	std::string name, value;
+	if (!split(arg, name, value))
+		return false;
+
+	if (name == "index")
+		return parse_index(value, index);
+	if (name == "header" && value.empty())
+		return (header = true);
+	if (name == "texture")
+		return parse_texture(value, texture);
+	if (name == "pixel-format")
+		return img::parse_format(value, pixel_format);
+	if (name == "dither")
+		return img::parse_dither(value, dither);
+	if (name == "quality")
+		return img::parse_quality(value, quality);
+	if (name == "etc1-alpha")
+		return img::parse_alpha_layout(value, etc1_alpha);
+	if (name == "block-align")
+		return parse_align(value, block_align);
+	if (name == "mipmaps")
+		return parse_mipmaps(value, mipmaps);
+	if (name == "scale")
+		return parse_scale(value, scale);
+	if (name == "filter")
+		return img::parse_filter(value, filter);
+	if (name == "resolutions")
+		return parse_resolutions(value, resolutions);
+	if (name == "max-size")
+		return parse_size(value, max_size);
+	if (name == "premultiply-alpha" && value.empty())
+		return (premultiply_alpha = true);
+	if (name == "auto-format" && value.empty())
+		return (auto_format = true);
+	if (name == "channel-pack" && value.empty())
+		return (channel_pack = true);
+	if (name == "split-alpha" && value.empty())
+		return (split_alpha = true);
+	if (name == "jpeg-alpha")
+		return parse_alpha_mask(value, jpeg_alpha);
+	if (name == "png8" && value.empty())
+		return (png8 = true);
+	if (name == "polygons")
+		return parse_polygons(value, polygons);
+	if (name == "profiles")
+		return !(profiles = value).empty();
+
+	//"--no-<option>" turns a flag or an optional output off again, so sheets can override the command line
+	if (name.compare(0, 3, "no-") == 0 && value.empty())
+	{
+		std::string flag = name.substr(3);
+		if (flag == "header") header = false;
+		else if (flag == "block-align") block_align = 0;
+		else if (flag == "mipmaps") mipmaps = 0;
+		else if (flag == "premultiply-alpha") premultiply_alpha = false;
+		else if (flag == "auto-format") auto_format = false;
+		else if (flag == "channel-pack") channel_pack = false;
+		else if (flag == "split-alpha") split_alpha = false;
+		else if (flag == "jpeg-alpha") jpeg_alpha = alpha_mask_none;
+		else if (flag == "png8") png8 = false;
+		else if (flag == "polygons") polygons = 0;
+		else return false;
+		return true;
+	}
+
+	return false;
+}
+
+bool options::check() const
+{
+	//Block compressed textures need a container that can hold them
+	bool compressed = img::is_compressed(pixel_format);
+	bool etc = (pixel_format == img::etc1 || pixel_format == img::etc2_rgba);
+	bool supported;
+	switch (texture)
+	{
+	case texture_dds: supported = compressed && !etc && !img::is_astc(pixel_format); break;
+	case texture_pkm: supported = etc; break;
+	case texture_astc: supported = img::is_astc(pixel_format); break;
+	case texture_ktx: supported = true; break;
+	default: supported = !compressed; break;
+	}
+
+	if (!supported)
+	{
+		printf("[TEX] %s textures can't be stored as %s\n", img::format_name(pixel_format), texture_extension(texture));
+		return false;
+	}
+
+	//Mip levels of a texture twice as high wouldn't be the stacked levels loaders work out from its size
+	if (pixel_format == img::etc1 && etc1_alpha == img::alpha_bottom && mipmaps > 0)
+	{
+		printf("[TEX] --etc1-alpha=bottom can't be used with --mipmaps\n");
+		return false;
+	}
+
+	//Channel packed sprites need four channels that are stored apart
+	//Block formats share endpoints and weights between R, G and B, so masks would bleed into each other
+	if (channel_pack)
+	{
+		bool separate = (pixel_format == img::rgba8888 || pixel_format == img::rgba4444);
+		if (!separate)
+		{
+			printf("[TEX] %s textures can't be channel packed\n", img::format_name(pixel_format));
+			return false;
+		}
+		if (auto_format || premultiply_alpha || split_alpha || jpeg_alpha != alpha_mask_none || png8)
+		{
+			printf("[TEX] Channel packing can't be used with --auto-format, --premultiply-alpha, --split-alpha, --jpeg-alpha or --png8\n");
+			return false;
+		}
+	}
+
+	//JPEGs are only written in place of PNGs
+	if (jpeg_alpha != alpha_mask_none && texture != texture_png)
+	{
+		printf("[TEX] --jpeg-alpha needs --texture=png\n");
+		return false;
+	}
+	if (png8 && texture != texture_png)
+	{
+		printf("[TEX] --png8 needs --texture=png\n");
+		return false;
+	}
+
+	return true;
+}
+
+unsigned options::alignment() const
+{
+	unsigned align = std::max(block_align, 1u);
+	if (block_align == block_align_format)
+	{
+		unsigned height, bytes;
+		img::format_block(pixel_format, align, height, bytes);
+	}
+
+	//Sprites stay apart down to the mip level if the grid is also a multiple of 2^mipmaps
+	//Least common multiple - the greatest common divisor with a power of 2 is the lowest set bit
+	if (mipmaps > 0)
+	{
+		unsigned step = 1u << mipmaps;
+		align = align / std::min(align & (0u - align), step) * step;
+	}
+
+	return align;
+}
+
+unsigned options::texture_limit() const
+{
+	unsigned limit = (!(index & index_binary) && !header) ? 0 : index_max_size;
+
+	//Alpha below the color doubles the height, which has to fit the 16 bits of index and PKM headers
+	if (pixel_format == img::etc1 && etc1_alpha == img::alpha_bottom)
+		limit = index_max_size / 2;
+
+	return (max_size > 0 && (limit == 0 || max_size < limit)) ? max_size : limit;
+}
+
+void options::usage()
+{
+	printf("Options:\n");
+	printf("  --index=plist|bin[,...]   index files to write (default plist)\n");
+	printf("  --header                  write a C++ header with sprite IDs and a perfect hash\n");
+	printf("  --texture=png|pvr|pvr.ccz|dds|ktx|pkm|astc|raw|qoi\n");
+	printf("                            texture file format, raw is the packed pixels only, qoi is\n");
+	printf("                            lossless and fast for iteration builds (default png)\n");
+	printf("  --pixel-format=RGBA8888|RGBA4444|RGB565|RGBA5551|RGB888|BC1|BC3|BC7|ETC1|ETC2_RGBA\n");
+	printf("                 |ASTC_4x4|ASTC_6x6|ASTC_8x8|A8|I8|AI88\n");
+	printf("                            texture pixel format (default RGBA8888)\n");
+	printf("  --dither=none|ordered|floyd-steinberg\n");
+	printf("                            dithering for pixel formats below 8 bits (default none)\n");
+	printf("  --quality=fast|normal|best\n");
+	printf("                            block compression preset (default normal)\n");
+	printf("  --etc1-alpha=none|separate|bottom\n");
+	printf("                            where ETC1 keeps alpha: dropped, a second '@alpha' texture\n");
+	printf("                            or the bottom half of a twice as high texture (default none)\n");
+	printf("  --block-align[=N]         snap sprites to an N pixel grid, by default the pixel format's\n");
+	printf("                            block, so no compressed block holds two sprites (default off)\n");
+	printf("  --mipmaps[=N]             write the mip chain, in the texture for pvr, dds and ktx,\n");
+	printf("                            as '@mip<level>' files otherwise; sprites are padded to stay\n");
+	printf("                            apart down to level N (default 2)\n");
+	printf("  --scale=F                 scale all sprites, on top of their own scale (default 1)\n");
+	printf("  --filter=mitchell|lanczos filter for scaling sprites (default mitchell)\n");
+	printf("  --resolutions=N[,...]     write every sheet at several resolutions, as '<sheet>@<N>x',\n");
+	printf("                            the source art being the highest one (eg. 1,2,4)\n");
+	printf("  --max-size=N              biggest texture side, sheets that don't fit fail (default none)\n");
+	printf("  --premultiply-alpha       store colors premultiplied by alpha\n");
+	printf("  --auto-format             pick the cheapest uncompressed format from the sprites: A8, I8,\n");
+	printf("                            AI88, JPEG, RGB565, a palettized PNG or RGBA5551\n");
+	printf("  --channel-pack            pack sprites as masks into the R, G, B and A channels separately,\n");
+	printf("                            so one RGBA8888 or RGBA4444 texture holds four mask sheets\n");
+	printf("  --split-alpha             pack opaque sprites into a second texture, '<sheet>@opaque', as a JPEG\n");
+	printf("                            for png, otherwise without alpha (eg. RGB565, BC1, ETC1)\n");
+	printf("  --jpeg-alpha[=png|zlib]   write png textures as a JPEG of the colors and an 8-bit alpha mask,\n");
+	printf("                            '<name>@alpha.png' or zlib compressed '<name>@alpha.raw.z'\n");
+	printf("  --png8                    write palettized png textures, reduced to 256 colors (median cut,\n");
+	printf("                            with --dither) if there are more\n");
+	printf("  --polygons[=N]            write a convex polygon mesh of every sprite's visible pixels into\n");
+	printf("                            the plist, so less empty space is drawn (N corners where they fit, default 8)\n");
+	printf("  --profiles=file.json      write every sheet once per profile, each with its own options,\n");
+	printf("                            to a folder named after it\n");
+	printf("  --no-<option>             turn a flag or optional output off again (eg. --no-header,\n");
+	printf("                            --no-mipmaps), for sheets overriding the command line\n");
+}
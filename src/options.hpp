@@ -0,0 +1,156 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include "img/pixel_format.hpp"
+#include "img/block.hpp"
+#include "img/resample.hpp"
+
+#include <string>
+#include <vector>
+
+//Index file formats (can be combined)
+enum index_format : unsigned
+{
+	//Texture Packer compatible .plist (Cocos2D)
+	index_plist = 1 << 0,
+	//Compact binary .tpi (see atlas_index.hpp)
+	index_binary = 1 << 1,
+};
+
+//Texture file formats
+enum texture_format : unsigned
+{
+	//.png
+	texture_png,
+	//.pvr (PVR v3, raw pixels)
+	texture_pvr,
+	//.pvr.ccz (PVR v3, zlib compressed)
+	texture_pvr_ccz,
+	//.dds (block compressed)
+	texture_dds,
+	//.ktx (KTX v1, raw or block compressed)
+	texture_ktx,
+	//.pkm (ETC1/ETC2)
+	texture_pkm,
+	//.astc (ASTC)
+	texture_astc,
+	//.raw (packed pixels, no header)
+	texture_raw,
+	//.qoi (lossless, much faster to write and read than PNG)
+	texture_qoi,
+};
+
+//Alpha mask files of --jpeg-alpha
+enum alpha_mask_format : unsigned
+{
+	//No mask, textures keep their alpha
+	alpha_mask_none,
+	//"<name>@alpha.png", 8-bit gray PNG
+	alpha_mask_png,
+	//"<name>@alpha.raw.z", zlib compressed 8-bit alpha (no header)
+	alpha_mask_zlib,
+};
+
+//options::block_align - align to the block footprint of the pixel format
+const unsigned block_align_format = ~0u;
+//Biggest alignment grid accepted
+const unsigned block_align_max = 64;
+//options::mipmaps - sprites stay apart down to this level by default
+const unsigned mipmaps_default = 2;
+//Deepest level sprites can be kept apart at
+const unsigned mipmaps_max = 6;
+//Biggest texture side the binary index and the generated header can hold (their sizes are 16-bit)
+const unsigned index_max_size = 32768;
+//options::polygons - corners of sprite polygons by default
+const unsigned polygon_vertices_default = 8;
+//Most corners a sprite polygon can have
+const unsigned polygon_vertices_max = 64;
+
+//File extension of a texture format (eg. ".pvr.ccz")
+const char * texture_extension(texture_format format);
+//Does a texture format store mip levels (others get a file per level)
+bool texture_mipmaps(texture_format format);
+//File name suffix of an alpha mask format (eg. "@alpha.png")
+const char * alpha_mask_extension(alpha_mask_format format);
+
+//Output options for packing spritesheets
+struct options
+{
+	//Index files to write (index_format flags)
+	unsigned index;
+	//Write a C++ header with sprite IDs next to the index
+	bool header;
+	//Texture file format
+	texture_format texture;
+	//Texture pixel format
+	img::pixel_format pixel_format;
+	//Dithering when reducing to the pixel format
+	img::dither_mode dither;
+	//Block compression speed/quality preset
+	img::encode_quality quality;
+	//Where ETC1 textures keep alpha
+	img::alpha_layout etc1_alpha;
+	//Grid sprites are snapped to, in pixels (0 = off, block_align_format = the pixel format's block)
+	unsigned block_align;
+	//Write mip levels (0 = off, otherwise the level sprites are padded to stay apart down to)
+	unsigned mipmaps;
+	//Scale of all sprites (on top of their own)
+	float scale;
+	//Filter for scaling sprites
+	img::resample_filter filter;
+	//Resolutions to write every sheet at, as "<sheet>@<n>x" (empty = the source resolution only)
+	//The source art is at the highest one, the others are scaled down from it
+	std::vector<unsigned> resolutions;
+	//Biggest texture side (0 = no limit)
+	unsigned max_size;
+	//JSON file with output profiles (see README), empty for a single output
+	std::string profiles;
+	//Store colors premultiplied by alpha
+	bool premultiply_alpha;
+	//Pick the cheapest uncompressed pixel format (and PNG flavor) from the sprites' pixels
+	bool auto_format;
+	//Pack sprites as masks into the R, G, B and A channels separately, up to four layouts per texture
+	bool channel_pack;
+	//Pack opaque sprites into a second texture, in a format without alpha
+	bool split_alpha;
+	//Write PNG textures as a JPEG of the colors and a mask file of the alpha
+	alpha_mask_format jpeg_alpha;
+	//Write palettized PNGs, reduced to 256 colors if there are more
+	bool png8;
+	//Write polygon meshes of sprites into the plist, with at most this many corners (0 = off)
+	unsigned polygons;
+
+	//Construct the default options
+	options();
+
+	//Parse a command line option (eg. "--index=bin"), false if unknown or invalid
+	bool parse(const std::string & arg);
+	//Check that the options work together, prints the problem if not
+	bool check() const;
+	//Grid sprites are packed on (1 when they aren't aligned)
+	unsigned alignment() const;
+	//Biggest texture side, max_size limited to what the index files and the alpha layout hold (0 = no limit)
+	unsigned texture_limit() const;
+
+	//Print the option list
+	static void usage();
+};
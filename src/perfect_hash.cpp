@@ -0,0 +1,122 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "perfect_hash.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	//Average number of keys per bucket
+	const size_t keys_per_bucket = 4;
+	//Give up on a bucket after this many displacements
+	const int32_t max_displacement = 1 << 20;
+}
+
+namespace perfect_hash
+{
+	uint32_t hash(const char * key, uint32_t seed)
+	{
+		uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+		while (*key)
+		{
+			h ^= (unsigned char)*key++;
+			h *= 16777619u;
+		}
+
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	bool build(const std::vector<std::string> & keys, std::vector<int32_t> & displace, std::vector<uint32_t> & slots)
+	{
+		const size_t count = keys.size();
+		const size_t buckets = std::max<size_t>(1, (count + keys_per_bucket - 1) / keys_per_bucket);
+
+		displace.assign(buckets, 0);
+		slots.assign(count, 0);
+		if (count == 0) return true;
+
+		std::vector<std::vector<size_t>> members(buckets);
+		for (size_t i = 0; i < count; ++i)
+			members[hash(keys[i].c_str(), 0) % buckets].push_back(i);
+
+		//Place the biggest buckets first, while there is most room
+		std::vector<size_t> order(buckets);
+		for (size_t b = 0; b < buckets; ++b) order[b] = b;
+		std::stable_sort(order.begin(), order.end(),
+			[&members](size_t a, size_t b) { return members[a].size() > members[b].size(); });
+
+		std::vector<bool> taken(count, false);
+		std::vector<uint32_t> candidate;
+		size_t next_free = 0;
+
+		for (auto b : order)
+		{
+			auto & bucket = members[b];
+			if (bucket.empty()) break;
+
+			//Single keys go straight into a free slot
+			if (bucket.size() == 1)
+			{
+				while (taken[next_free]) ++next_free;
+				taken[next_free] = true;
+				slots[bucket[0]] = (uint32_t)next_free;
+				displace[b] = -(int32_t)next_free - 1;
+				continue;
+			}
+
+			bool placed = false;
+			for (int32_t d = 1; d < max_displacement && !placed; ++d)
+			{
+				candidate.clear();
+				for (auto key : bucket)
+				{
+					uint32_t slot = hash(keys[key].c_str(), (uint32_t)d) % count;
+					if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+						break;
+					candidate.push_back(slot);
+				}
+
+				if (candidate.size() != bucket.size())
+					continue;
+
+				for (size_t i = 0; i < bucket.size(); ++i)
+				{
+					taken[candidate[i]] = true;
+					slots[bucket[i]] = candidate[i];
+				}
+
+				displace[b] = d;
+				placed = true;
+			}
+
+			//Only happens with duplicate keys
+			if (!placed) return false;
+		}
+
+		return true;
+	}
+}
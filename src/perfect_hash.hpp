@@ -0,0 +1,40 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Minimal perfect hashing (hash and displace)
+//Every key is assigned a distinct slot in [0, N), looked up as:
+//	d = displace[hash(key, 0) % B]
+//	slot = (d < 0) ? (-d - 1) : (hash(key, d) % N)
+namespace perfect_hash
+{
+	//Seeded string hash (FNV-1a with a murmur finalizer)
+	//Generated code contains an identical constexpr version
+	uint32_t hash(const char * key, uint32_t seed);
+
+	//Build a minimal perfect hash for unique keys
+	//Outputs the displacement table and the slot of every key
+	bool build(const std::vector<std::string> & keys, std::vector<int32_t> & displace, std::vector<uint32_t> & slots);
+}
@@ -75,7 +75,33 @@ namespace plist
 
 		TAB4 PKEY("textureRotated") "\n"
 		TAB4 "<%s/>\n"
+		);
+
+	//channel of a channel packed frame (0-3 = R, G, B, A)
+	key(frame_channel,
+		TAB4 PKEY("channel") "\n"
+		TAB4 "<integer>%d</integer>\n"
+		);
+
+	//nine-slice middle X Y W H, in the sprite
+	key(frame_slice,
+		TAB4 PKEY("capInsets") "\n"
+		TAB4 "<string>{{%d,%d},{%d,%d}}</string>\n"
+		);
+
+	//polygon mesh: triangles, vertices (in the sprite), verticesUV (in the texture)
+	key(frame_polygon,
+		TAB4 PKEY("triangles") "\n"
+		TAB4 "<string>%r</string>\n"
+
+		TAB4 PKEY("vertices") "\n"
+		TAB4 "<string>%r</string>\n"
 
+		TAB4 PKEY("verticesUV") "\n"
+		TAB4 "<string>%r</string>\n"
+		);
+
+	key(frame_end,
 		TAB3 "</dict>\n"
 		);
 
@@ -83,7 +109,7 @@ namespace plist
 		TAB2 "</dict>\n"
 		);
 
-	//realTextureFileName, size X Y, textureFileName
+	//pixelFormat, realTextureFileName, size X Y, textureFileName
 	key(metadata,
 		TAB2 PKEY("metadata") "\n"
 		TAB2 "<dict>\n"
@@ -92,10 +118,10 @@ namespace plist
 		TAB3 "<integer>3</integer>\n"
 
 		TAB3 PKEY("pixelFormat") "\n"
-		TAB3 "<string>RGBA8888</string>\n"
+		TAB3 "<string>%s</string>\n"
 
 		TAB3 PKEY("premultiplyAlpha") "\n"
-		TAB3 "<false/>\n"
+		TAB3 "<%s/>\n"
 
 		TAB3 PKEY("realTextureFileName") "\n"
 		TAB3 "<string>%s</string>\n"
@@ -105,7 +131,15 @@ namespace plist
 
 		TAB3 PKEY("textureFileName") "\n"
 		TAB3 "<string>%s</string>\n"
+		);
+
+	//alpha mask fname (--jpeg-alpha)
+	key(metadata_alpha,
+		TAB3 PKEY("alphaTextureFileName") "\n"
+		TAB3 "<string>%s</string>\n"
+		);
 
+	key(metadata_end,
 		TAB2 "</dict>\n"
 		);
 
@@ -114,3 +148,6 @@ namespace plist
 		"</plist>\n"
 		);
 }
+
+//"key" is too generic a name to leak outside this header
+#undef key
@@ -22,13 +22,30 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 #include "texture_packer.hpp"
 #include "binpack.hpp"
 #include "plist.hpp"
+#include "emitter.hpp"
+#include "atlas_index.hpp"
+#include "perfect_hash.hpp"
 
 #include "img/img.hpp"
 #include "img/png.hpp"
 #include "img/jpeg.hpp"
+#include "img/pvr.hpp"
+#include "img/dds.hpp"
+#include "img/ktx.hpp"
+#include "img/pkm.hpp"
+#include "img/astc.hpp"
+#include "img/raw.hpp"
+#include "img/qoi.hpp"
+#include "img/quantize.hpp"
+#include "img/mipmap.hpp"
+#include "img/resample.hpp"
+#include "img/analyze.hpp"
 #include "io/io.hpp"
+#include "util/parallel.hpp"
 
 #include <assert.h>
+#include <math.h>
+#include <exception>
 
 int max(int a, int b)
 {
@@ -57,20 +74,93 @@ const char * itostr(int n)
 	return itostr_out;
 }
 
+//Turn a sprite or sheet name into a C++ identifier
+std::string identifier(const std::string & name)
+{
+	static const char * keywords[] = {
+		"alignas", "alignof", "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class",
+		"const", "constexpr", "continue", "default", "delete", "do", "double", "else", "enum", "explicit",
+		"export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+		"mutable", "namespace", "new", "noexcept", "not", "nullptr", "operator", "or", "private",
+		"protected", "public", "register", "return", "short", "signed", "sizeof", "static", "struct",
+		"switch", "template", "this", "throw", "true", "try", "typedef", "typename", "union", "unsigned",
+		"using", "virtual", "void", "volatile", "while", "xor", "invalid",
+	};
+
+	std::string result;
+	for (auto c : name)
+		result.push_back(isalnum((unsigned char)c) ? c : '_');
+
+	if (result.empty() || isdigit((unsigned char)result[0]))
+		result.insert(result.begin(), '_');
+
+	for (auto keyword : keywords)
+		if (result == keyword) result.push_back('_');
+
+	return result;
+}
+
+//Escape text for a C++ string literal
+std::string literal(const std::string & text)
+{
+	std::string result;
+	for (auto c : text)
+	{
+		if (c == '\\' || c == '"') result.push_back('\\');
+		result.push_back(c);
+	}
+
+	return result;
+}
+
+//Space separated numbers, as plist polygons have them
+std::string number_list(const std::vector<int> & numbers)
+{
+	std::string result;
+	for (auto n : numbers)
+	{
+		if (!result.empty()) result.push_back(' ');
+		result += std::to_string(n);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////
+
+sprite_images::~sprite_images()
+{
+	for (auto & it : _images)
+		delete it.second;
+}
+
+const img::img * sprite_images::get(const std::string & fname)
+{
+	auto it = _images.find(fname);
+	if (it != _images.end())
+		return it->second;
+
+	//Failures are kept too, so they aren't decoded again
+	img::img * image = img::img::loadimg(fname);
+	_images[fname] = image;
+	return image;
+}
+
 ////////////////////////////////////////////////////////////////////
 
-texture_packer::texture_packer(bool alpha, const std::string & base_dir)
-	: _img(nullptr)
-	, _generated(false)
+texture_packer::texture_packer(bool alpha, const std::string & base_dir, const options & opts, std::shared_ptr<sprite_images> images)
+	: _generated(false)
 	, _alpha(alpha)
 	, _base_dir(base_dir + "\\")
+	, _options(opts)
+	, _images(images ? images : std::make_shared<sprite_images>())
 {
 }
 
 texture_packer::~texture_packer()
 {
-	if (_img != nullptr)
-		delete _img;
+	for (auto & pg : _pages)
+		delete pg.image;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -83,7 +173,7 @@ bool texture_packer::add(const sprite & spr)
 		return false;
 	}
 
-	if (!core::fs::exists(_base_dir + spr.path))
+	if (!core::io::exists(_base_dir + spr.path))
 	{
 		printf("[TEX] Can't find '%s'\n", spr.path.c_str());
 		return false;
@@ -98,19 +188,20 @@ bool texture_packer::add(const sprite & spr)
 int texture_packer::pack()
 {
 	std::vector<int> order;
-	std::vector<util::rect> rects;
+	std::vector<img::png *> images;
 
 	int i = 0;
-	for (auto spr : _sprites)
+	for (auto & spr : _sprites)
 	{
-		try
+		auto image = prepare(spr);
+		if (image != nullptr)
 		{
-			auto img = img::img::load_extended(_base_dir + spr.path);
-			rects.push_back(util::rect(0, 0, img->w(), img->h()));
+			if (_options.channel_pack)
+				img::to_coverage(*image);
+			images.push_back(image);
 			order.push_back(i);
-			delete img;
 		}
-		catch (...)
+		else
 		{
 			printf("[TEX] '%s' has unsupported format\n", spr.path.c_str());
 		}
@@ -118,25 +209,241 @@ int texture_packer::pack()
 		i++;
 	}
 
-	pack_internal(rects, order);
+	//Opaque sprites get a page of their own, in a format without alpha
+	std::vector<img::png *> translucent, opaque;
+	std::vector<int> translucent_order, opaque_order;
+	for (size_t n = 0; n < images.size(); ++n)
+	{
+		if (_options.split_alpha && img::analyze({ images[n] }).opaque)
+		{
+			opaque.push_back(images[n]);
+			opaque_order.push_back(order[n]);
+		}
+		else
+		{
+			translucent.push_back(images[n]);
+			translucent_order.push_back(order[n]);
+		}
+	}
+
+	bool success = true;
+	if (!translucent.empty())
+		success = pack_page(translucent, translucent_order, !_alpha, "");
+	if (success && !opaque.empty())
+		success = pack_page(opaque, opaque_order, true, _pages.empty() ? "" : "@opaque");
+	for (auto image : images)
+		delete image;
+
+	//Sheets are written whole or not at all
+	_generated = success && !_pages.empty();
+	if (!_generated)
+	{
+		for (auto & pg : _pages)
+			delete pg.image;
+		_pages.clear();
+		_info.clear();
+	}
+
 	return (_info.size());
 }
 
-void texture_packer::pack_internal(const std::vector<util::rect> & rects, const std::vector<int> & order)
+bool texture_packer::pack_page(const std::vector<img::png *> & images, const std::vector<int> & order, bool opaque, const std::string & suffix)
+{
+	page pg;
+	pg.image = nullptr;
+	pg.format = (opaque && _alpha) ? opaque_format() : _options.pixel_format;
+	pg.opaque = opaque;
+	pg.jpeg = false;
+	pg.alpha_mask = false;
+	pg.layout = img::png_rgba;
+	pg.suffix = suffix;
+
+	//Only uncompressed textures can be picked from
+	bool auto_format = _options.auto_format && !img::is_compressed(pg.format);
+	img::pixel_format requested = pg.format;
+	std::string found;
+	if (auto_format)
+		found = choose_format(images, pg);
+
+	//Gray PNGs stay PNGs
+	pg.jpeg = pg.opaque && _options.texture == texture_png && pg.format != img::l8;
+
+	//Pages with alpha become a JPEG and a mask, except for the single channel ones
+	if (!pg.jpeg && _options.jpeg_alpha != alpha_mask_none && pg.format != img::l8 && pg.format != img::a8)
+		pg.jpeg = pg.alpha_mask = true;
+
+	//Gray PNGs are as small as palettized ones
+	bool gray = (pg.format == img::l8 || pg.format == img::a8 || pg.format == img::la88);
+	if (_options.png8 && !pg.jpeg && !gray)
+		pg.layout = img::png_indexed;
+
+	if (!pack_internal(images, order, pg))
+		return false;
+
+	if (auto_format)
+	{
+		const page & packed = _pages.back();
+		size_t pixels = (size_t)packed.image->w() * packed.image->h();
+		printf("[TEX] Auto format: %s -> %s%s, %u bytes in memory instead of %u\n", found.c_str(), img::format_name(packed.format),
+			packed.jpeg ? " JPEG" : (packed.layout == img::png_indexed ? " palettized PNG" : ""),
+			(unsigned)(pixels * img::format_size(packed.format)), (unsigned)(pixels * img::format_size(requested)));
+	}
+
+	return true;
+}
+
+img::pixel_format texture_packer::opaque_format() const
+{
+	//PNG textures of opaque sprites are written as JPEGs
+	if (_options.texture == texture_png)
+		return img::rgb888;
+
+	switch (_options.pixel_format)
+	{
+	case img::rgba8888: case img::rgba4444: case img::rgba5551: return img::rgb565;
+	case img::bc3: case img::bc7: return img::bc1;
+	case img::etc2_rgba: return img::etc1;
+	case img::a8: case img::la88: return img::l8;
+	default: return _options.pixel_format;
+	}
+}
+
+img::alpha_layout texture_packer::etc1_alpha(const page & pg) const
+{
+	return pg.opaque ? img::alpha_none : _options.etc1_alpha;
+}
+
+std::string texture_packer::choose_format(const std::vector<img::png *> & images, page & pg)
+{
+	std::vector<const img::img *> sources(images.begin(), images.end());
+	img::content content = img::analyze(sources);
+	bool png = (_options.texture == texture_png);
+
+	std::string found = content.opaque ? "opaque" : (content.binary_alpha ? "1-bit alpha" : "alpha");
+	if (content.gray) found += ", gray";
+	if (content.mask) found += ", alpha mask";
+	found += (content.colors > img::max_palette) ? ", many colors" : ", " + std::to_string(content.colors) + " colors";
+
+	//A8 is white with alpha, so only white masks fit it
+	bool white_mask = content.mask && content.mask_color.r == 255 && content.mask_color.g == 255 && content.mask_color.b == 255;
+
+	//Single channel formats lose nothing
+	if (white_mask || (content.opaque && content.gray))
+	{
+		pg.format = white_mask ? img::a8 : img::l8;
+	}
+	//Gray with alpha - two channels
+	else if (content.gray)
+	{
+		pg.format = img::la88;
+	}
+	//No alpha - JPEG for PNGs, 16-bit otherwise
+	else if (content.opaque)
+	{
+		if (png)
+		{
+			pg.opaque = true;
+			pg.format = img::rgb888;
+		}
+		else
+		{
+			pg.format = img::rgb565;
+		}
+	}
+	//Few colors - a lossless palettized PNG
+	else if (png && content.colors <= img::max_palette)
+	{
+		pg.layout = img::png_indexed;
+	}
+	else if (content.binary_alpha)
+	{
+		pg.format = img::rgba5551;
+	}
+
+	return found;
+}
+
+util::vec2 texture_packer::scale(const sprite & spr) const
+{
+	//Sprites without a scale aren't scaled
+	float x = (spr.scale.x > 0.0f) ? spr.scale.x : 1.0f;
+	float y = (spr.scale.y > 0.0f) ? spr.scale.y : 1.0f;
+	return util::vec2(x * _options.scale, y * _options.scale);
+}
+
+img::png * texture_packer::prepare(sprite & spr)
+{
+	auto source = _images->get(_base_dir + spr.path);
+	if (source == nullptr) return nullptr;
+
+	util::vec2 sc = scale(spr);
+	unsigned w = std::max(1u, (unsigned)(source->w() * sc.x + 0.5f));
+	unsigned h = std::max(1u, (unsigned)(source->h() * sc.y + 0.5f));
+	if (w == source->w() && h == source->h() && !spr.nine_slice)
+		return img::img::extended(*source);
+
+	img::png * scaled = nullptr;
+	if (w != source->w() || h != source->h())
+		scaled = img::resample(*source, w, h, _options.filter);
+	const img::img & image = (scaled != nullptr) ? *scaled : *source;
+	if (!spr.nine_slice)
+	{
+		img::png * result = img::img::extended(image);
+		delete scaled;
+		return result;
+	}
+
+	//Nine-slices keep their borders and three lines of a repeated middle
+	img::insets & borders = spr.slice;
+	bool found = (borders.left == 0 && borders.top == 0 && borders.right == 0 && borders.bottom == 0);
+	if (found)
+	{
+		borders = img::find_insets(image);
+	}
+	else
+	{
+		borders.left = (unsigned)(borders.left * sc.x + 0.5f);
+		borders.top = (unsigned)(borders.top * sc.y + 0.5f);
+		borders.right = (unsigned)(borders.right * sc.x + 0.5f);
+		borders.bottom = (unsigned)(borders.bottom * sc.y + 0.5f);
+	}
+
+	//Found borders are around identical lines, set ones may not be
+	img::png * sliced = img::compact_slices(image, borders);
+	bool kept = (image.w() > borders.left + borders.right + img::middle_lines && sliced->w() == image.w())
+		|| (image.h() > borders.top + borders.bottom + img::middle_lines && sliced->h() == image.h());
+	if (!found && kept)
+		printf("[TEX] '%s' isn't the same all across its nine-slice middle, it's kept whole\n", spr.name.c_str());
+
+	img::png * result = img::img::extended(*sliced);
+	delete sliced;
+	delete scaled;
+	return result;
+}
+
+bool texture_packer::pack_internal(const std::vector<img::png *> & images, const std::vector<int> & order, page pg)
 {
 	using namespace core;
 	using binrect = binpack::rect_xywhf;
 
-	//allocate binpack rectangles
-	binrect ** rectptr = new binrect*[rects.size()];
-	for (size_t i = 0; i < rects.size(); i++)
+	//Aligned sprites are packed in grid cells, so every position and size is a multiple of the grid
+	const int align = (int)_options.alignment();
+
+	//allocate binpack rectangles, their context is the index of the image
+	std::vector<size_t> ids(images.size());
+	binrect ** rectptr = new binrect*[images.size()];
+	for (size_t i = 0; i < images.size(); i++)
 	{
-		rectptr[i] = new binrect(0, 0, rects[i].w, rects[i].h);
-		rectptr[i]->context = (void*)&_sprites[order[i]];
+		ids[i] = i;
+		rectptr[i] = new binrect(0, 0, ((int)images[i]->w() + align - 1) / align, ((int)images[i]->h() + align - 1) / align);
+		rectptr[i]->context = (void*)&ids[i];
 	}
 
+	//Channel packing takes a bin per channel
+	const size_t channels = _options.channel_pack ? 4 : 1;
+
 	//attempt to package
-	bool success;
+	bool success = false;
 	std::vector<binpack::bin> bins;
 	//Final atlas sizes to try
 	int final_size = 0;
@@ -147,79 +454,310 @@ void texture_packer::pack_internal(const std::vector<util::rect> & rects, const
 
 	for (auto sz : binsizes)
 	{
+		unsigned limit = _options.texture_limit();
+		if (limit > 0 && (unsigned)(sz * align) > limit)
+		{
+			printf("[TEX] Sprites don't fit in %ux%u\n", limit, limit);
+			break;
+		}
+
 		bins.clear();
-		success = binpack::bin::pack(rectptr, rects.size(), sz, bins);
-		success = (bins.size() == 1);
+		success = binpack::bin::pack(rectptr, images.size(), sz, bins);
+		success = (!bins.empty() && bins.size() <= channels);
 		if (!success) continue;
 		
 		//stop if solution found
-		final_size = sz;
+		final_size = sz * align;
 		break;
 	}
 
 	//Celebrate ^^
 	if (success)
 	{
-		_generated = true;
-
-		//Create final image
-		if (_alpha) _img = new img::png (final_size, final_size);
-		else		_img = new img::jpeg(final_size, final_size);
+		//Create final image, channels that hold no sprites stay empty
+		pg.image = create_image(pg, final_size, final_size);
+		if (_options.channel_pack)
+			memset(pg.image->data(), 0, (size_t)final_size * final_size * sizeof(img::color));
+		_pages.push_back(pg);
 
-		binpack::bin & res = bins[0];
-		for (auto blitrect : res.rects)
+		//Every bin is a channel when channel packing (there is a single one otherwise)
+		for (unsigned channel = 0; channel < bins.size(); ++channel)
 		{
-			auto spr = (sprite*)blitrect->context;
-			try //try png
+			for (auto blitrect : bins[channel].rects)
 			{
-				img::png * fpng = img::img::load_extended(_base_dir + spr->path);
-				blit(*spr, fpng, *blitrect);
-				delete fpng;
+				size_t id = *(size_t*)blitrect->context;
+				img::png * fpng = images[id];
+
+				//Offsets are in texture pixels too
+				sprite spr = _sprites[order[id]];
+				util::vec2 sc = scale(spr);
+				spr.offset = util::point((int)floorf(spr.offset.x * sc.x + 0.5f), (int)floorf(spr.offset.y * sc.y + 0.5f));
+
+				//Polygons of the sprite's own pixels, inside the extrusion
+				img::mesh mesh;
+				if (_options.polygons > 0)
+					mesh = img::polygon_mesh(*fpng, util::rect(1, 1, (int)fpng->w() - 2, (int)fpng->h() - 2), _options.polygons);
+
+				if (align == 1)
+				{
+					blit(spr, fpng, *blitrect, channel);
+					_info.back().mesh = mesh;
+					continue;
+				}
+
+				//Pad the extrusion out to the grid, so no block holds pixels of two sprites
+				unsigned w = (fpng->w() + align - 1) / align * align;
+				unsigned h = (fpng->h() + align - 1) / align * align;
+				img::png * padded = img::img::extend(*fpng, w, h);
+				binrect cellrect(*blitrect);
+				cellrect.x *= align;
+				cellrect.y *= align;
+				cellrect.w *= align;
+				cellrect.h *= align;
+				blit(spr, padded, cellrect, channel, w - fpng->w(), h - fpng->h());
+				_info.back().mesh = mesh;
+				delete padded;
 			}
-			catch (...)
-			{
-				
-				printf("[TEX] '%s' has usupported format\n", spr->path.c_str());
-			}			
 		}
 	}
 
 	//deallocate binpack rectangles
-	for (size_t i = 0; i < rects.size(); i++)
+	for (size_t i = 0; i < images.size(); i++)
 		delete rectptr[i];
 	delete[] rectptr;
+	return success;
+}
+
+img::img * texture_packer::create_image(const page & pg, unsigned w, unsigned h) const
+{
+	if (pg.jpeg)									return new img::jpeg(w, h);
+	else if (_options.texture == texture_png)
+	{
+		//Single channel formats are written as gray PNGs, masks palettized (the gray is always white)
+		img::png * result = new img::png(w, h);
+		if (pg.format == img::l8)						result->layout(img::png_gray);
+		else if (pg.format == img::a8)					result->layout(img::png_indexed);
+		else if (pg.format == img::la88)				result->layout(img::png_gray_alpha);
+		else											result->layout(pg.layout);
+		result->dither(_options.dither);
+		return result;
+	}
+	else if (_options.texture == texture_pvr)		return new img::pvr (w, h, pg.format, false);
+	else if (_options.texture == texture_pvr_ccz)	return new img::pvr (w, h, pg.format, true);
+	else if (_options.texture == texture_dds)		return new img::dds (w, h, pg.format, _options.quality);
+	else if (_options.texture == texture_ktx)		return new img::ktx (w, h, pg.format, _options.quality, etc1_alpha(pg));
+	else if (_options.texture == texture_pkm)		return new img::pkm (w, h, pg.format, _options.quality, etc1_alpha(pg));
+	else if (_options.texture == texture_raw)		return new img::raw (w, h, pg.format);
+	else if (_options.texture == texture_qoi)		return new img::qoi (w, h);
+	else											return new img::astc(w, h, pg.format, _options.quality);
 }
 
 void texture_packer::save(std::string & fname, std::string & index_fname)
 {
 	if (!_generated) pack();
-	if (_img == nullptr) return;
+	if (_pages.empty()) return;
+
+	std::string base_fname = fname;
+	std::vector<std::string> texture_fnames, alpha_fnames;
+	for (unsigned index = 0; index < _pages.size(); ++index)
+	{
+		page & pg = _pages[index];
+		img::img * image = pg.image;
+
+		std::string img_ext = pg.jpeg ? ".jpeg" : texture_extension(_options.texture);
+		std::string mip_fname = base_fname + pg.suffix + "@mip";
+		std::string page_fname = base_fname + pg.suffix + img_ext;
+		//core::console::info("[Atlas] Saving atlas to '%'\n", page_fname);
+
+		//Mips are filtered from the full precision atlas, every cell on its own
+		std::vector<img::png *> mips;
+		if (_options.mipmaps > 0)
+		{
+			mips = mipmaps(index);
+			for (auto mip : mips)
+			{
+				if (_options.premultiply_alpha) img::premultiply(*mip);
+				img::quantize(*mip, pg.format, _options.dither);
+			}
+		}
 
-	std::string img_ext = _alpha ? ".png" : ".jpeg";
-	fname += img_ext;
-	//core::console::info("[Atlas] Saving atlas to '%'\n", fname);
-	_img->save(fname);
+		//Premultiplied before reducing, so the stored values are exact in the pixel format
+		if (_options.premultiply_alpha)
+			img::premultiply(*image);
+
+		//PNGs get the reduced colors too, Cocos2D converts them to pixelFormat when loading
+		img::quantize(*image, pg.format, _options.dither);
+		if (!pg.jpeg && texture_mipmaps(_options.texture))
+		{
+			image->mipmaps(mips);
+			mips.clear();
+		}
+
+		save_texture(pg, *image, base_fname + pg.suffix, img_ext);
+
+		//Formats without mip levels get a file per level, "<name>@mip<level>.<ext>"
+		for (size_t i = 0; i < mips.size(); ++i)
+		{
+			img::img * level = create_image(pg, mips[i]->w(), mips[i]->h());
+			memcpy(level->data(), mips[i]->data(), (size_t)level->w() * level->h() * sizeof(img::color));
+			save_texture(pg, *level, mip_fname + std::to_string(i + 1), img_ext);
+			delete level;
+			delete mips[i];
+		}
+
+		core::fs::path outpath = page_fname;
+		texture_fnames.push_back(outpath.filename().string());
+		alpha_fnames.push_back(pg.alpha_mask ? outpath.stem().string() + alpha_mask_extension(_options.jpeg_alpha) : "");
+		if (index == 0) fname = page_fname;
+
+		//Cocos2D plists have a single texture, so every page gets its own
+		if (_options.index & index_plist)
+			save_plist(index_fname + pg.suffix + ".plist", texture_fnames.back(), alpha_fnames.back(), index);
+	}
+
+	if (_options.index & index_binary)
+		save_binary(index_fname + ".tpi", texture_fnames, alpha_fnames);
+	if (_options.header)
+		save_header(index_fname + ".hpp", texture_fnames);
+}
+
+void texture_packer::save_texture(const page & pg, img::img & image, const std::string & name, const std::string & ext) const
+{
+	if (!pg.alpha_mask)
+	{
+		image.save(name + ext);
+		return;
+	}
+
+	//The JPEG drops alpha, the mask keeps it at the same layout (8 bits, gray in PNGs)
+	auto save_mask = [&]()
+	{
+		std::string mask_fname = name + alpha_mask_extension(_options.jpeg_alpha);
+		size_t count = (size_t)image.w() * image.h();
+		const img::color * src = (const img::color *)image.data();
+		if (_options.jpeg_alpha == alpha_mask_zlib)
+		{
+			img::raw mask(image.w(), image.h(), img::a8, true);
+			memcpy(mask.data(), image.data(), count * sizeof(img::color));
+			mask.save(mask_fname);
+		}
+		else
+		{
+			img::png mask(image.w(), image.h());
+			img::color * dst = (img::color *)mask.data();
+			for (size_t i = 0; i < count; ++i)
+				dst[i].set(src[i].a, src[i].a, src[i].a, 255);
+			mask.layout(img::png_gray);
+			mask.save(mask_fname);
+		}
+	};
+
+	//Both files are encoded at the same time, errors are rethrown once both are done
+	std::exception_ptr errors[2];
+	util::parallel_bands(2, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			try
+			{
+				if (i == 0) image.save(name + ext);
+				else save_mask();
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+	});
+
+	for (auto & error : errors)
+		if (error) std::rethrow_exception(error);
+}
+
+std::vector<img::png *> texture_packer::mipmaps(unsigned index) const
+{
+	const img::img * image = _pages[index].image;
+
+	//Cell rectangles of a channel on the page (of all channels if negative)
+	auto regions = [this, index](int channel)
+	{
+		std::vector<util::rect> result;
+		for (auto & cell : _info)
+		{
+			if (cell.page != index) continue;
+			if (channel >= 0 && cell.channel != (unsigned)channel) continue;
+			//Flipped cells keep y at their bottom row
+			if (cell.flipped) result.push_back(util::rect(cell.x, cell.y - (int)cell.h, cell.w, cell.h + 1));
+			else result.push_back(util::rect(cell.x, cell.y, cell.w, cell.h));
+		}
+		return result;
+	};
+
+	if (!_options.channel_pack)
+		return img::build_mipmaps(*image, regions(-1));
+
+	//Channels hold layouts of their own, so every one is filtered apart
+	//Coverage goes through alpha, which is averaged linearly
+	std::vector<img::png *> result;
+	size_t count = (size_t)image->w() * image->h();
+	img::png coverage(image->w(), image->h());
+	for (unsigned channel = 0; channel < 4; ++channel)
+	{
+		const img::color::byte * src = image->data() + channel;
+		img::color * dst = (img::color *)coverage.data();
+		for (size_t i = 0; i < count; ++i)
+			dst[i].set(255, 255, 255, src[i * 4]);
+
+		//The first channel's levels are reused, the other channels overwrite the rest of them
+		auto levels = img::build_mipmaps(coverage, regions((int)channel));
+		bool first = result.empty();
+		if (first) result = levels;
+
+		for (size_t l = 0; l < levels.size(); ++l)
+		{
+			size_t level_count = (size_t)levels[l]->w() * levels[l]->h();
+			const img::color * level_src = (const img::color *)levels[l]->data();
+			img::color::byte * level_dst = result[l]->data() + channel;
+			for (size_t i = 0; i < level_count; ++i)
+				level_dst[i * 4] = level_src[i].a;
+
+			if (!first) delete levels[l];
+		}
+	}
+
+	return result;
+}
+
+void texture_packer::save_plist(const std::string & index_fname, const std::string & texture_fname, const std::string & alpha_fname, unsigned page_index)
+{
+	const page & pg = _pages[page_index];
 
-	std::string idx_ext = ".plist";
-	index_fname += idx_ext;
 	//core::console::info("[Atlas] Saving atlas index to '%'\n", index_fname);
-	core::fwriter writer(index_fname, true);
 
-	writer.write(plist::header);
+	//Templates are split into literals and slots only once
+	static const emitter::format frame_format(plist::frame);
+	static const emitter::format channel_format(plist::frame_channel);
+	static const emitter::format slice_format(plist::frame_slice);
+	static const emitter::format polygon_format(plist::frame_polygon);
+	static const emitter::format metadata_format(plist::metadata);
+	static const emitter::format alpha_format(plist::metadata_alpha);
 
-	writer.write(plist::frames_begin);
-	for (auto cell : _info)
+	emitter index;
+	index.write(plist::header);
+
+	index.write(plist::frames_begin);
+	for (auto & cell : _info)
 	{
-		sprite & spr = cell.sprite;
-		util::size size(cell.w - 2, cell.h - 2);
-		util::size scsize(size.width*spr.scale.x, size.height*spr.scale.y);
+		if (cell.page != page_index) continue;
+
+		const sprite & spr = cell.sprite;
+		util::size size(cell.w - 2 - cell.pad_w, cell.h - 2 - cell.pad_h);
 		util::point origin(cell.x + 1, cell.y + 1);
 		
-		//No idea how to fix the scaling
+		//Sprites are scaled when packing, so sizes are already in texture pixels
 
-		fprintf(writer.handle(), plist::frame,
+		index.emit(frame_format, {
 			//name
-			spr.name.c_str(),
+			spr.name,
 			//offset
 			spr.offset.x, spr.offset.y,
 			//size (-2 coz extensions for Cocos2D)
@@ -229,27 +767,350 @@ void texture_packer::save(std::string & fname, std::string & index_fname)
 			//src tex rect
 			origin.x, origin.y, size.width, size.height,
 			//flipped
-			cell.flipped ? "true" : "false");
+			cell.flipped ? "true" : "false" });
+
+		if (_options.channel_pack)
+			index.emit(channel_format, { cell.channel });
+		if (spr.nine_slice)
+		{
+			//Cap insets are the middle rect, like Cocos2D's Scale9Sprite takes them (in the unrotated sprite)
+			int sprite_w = cell.flipped ? (int)(cell.h + 1 - cell.pad_h) - 2 : size.width;
+			int sprite_h = cell.flipped ? (int)(cell.w - cell.pad_w) - 2 : size.height;
+			const img::insets & borders = spr.slice;
+			index.emit(slice_format, {
+				(int)borders.left, (int)borders.top,
+				sprite_w - (int)(borders.left + borders.right), sprite_h - (int)(borders.top + borders.bottom) });
+		}
+		if (!cell.mesh.vertices.empty())
+		{
+			//Cocos2D takes vertices in the sprite and verticesUV in the texture, both in pixels
+			//Rotated sprites have their rows going up from their bottom row
+			std::vector<int> triangles(cell.mesh.triangles.begin(), cell.mesh.triangles.end());
+			std::vector<int> vertices, uvs;
+			for (auto & v : cell.mesh.vertices)
+			{
+				vertices.push_back(v.x);
+				vertices.push_back(v.y);
+				uvs.push_back(cell.flipped ? origin.x + v.y : origin.x + v.x);
+				uvs.push_back(cell.flipped ? cell.y - v.x : origin.y + v.y);
+			}
+
+			index.emit(polygon_format, { number_list(triangles), number_list(vertices), number_list(uvs) });
+		}
+		index.write(plist::frame_end);
 	}
-	writer.write(plist::frames_end);
+	index.write(plist::frames_end);
 
-	core::fs::path outpath = fname;
-	core::fs::path outfile = outpath.filename();
-	std::string out = outfile.string();
-	fprintf(writer.handle(), plist::metadata,
+	index.emit(metadata_format, {
+		//pixel format
+		img::format_name(pg.format),
+		//premultiplied alpha
+		_options.premultiply_alpha ? "true" : "false",
 		//real tex fname
-		out.c_str(),
-		//size
-		_img->w(), _img->h(),
+		texture_fname,
+		//size (ETC1 alpha can make the texture taller)
+		pg.image->w(), img::layout_height(pg.image->h(), pg.format, etc1_alpha(pg)),
 		//tex fname
-		out.c_str());
+		texture_fname });
+
+	if (!alpha_fname.empty())
+		index.emit(alpha_format, { alpha_fname });
+	index.write(plist::metadata_end);
 
-	writer.write(plist::footer);
+	index.write(plist::footer);
+
+	core::fwriter writer(index_fname, true);
+	index.flush(writer);
+	writer.close();
+}
+
+void texture_packer::save_header(const std::string & header_fname, const std::vector<std::string> & texture_fnames)
+{
+	const std::string & texture_fname = texture_fnames[0];
+	std::string textures;
+	for (auto & name : texture_fnames)
+		textures += (textures.empty() ? "\"" : ", \"") + literal(name) + "\"";
+
+	//Perfect hashing needs unique names
+	std::vector<const cell *> cells;
+	std::vector<std::string> names;
+	for (auto & cell : _info)
+	{
+		if (std::find(names.begin(), names.end(), cell.sprite.name) != names.end())
+		{
+			printf("[TEX] Duplicate sprite name '%s' left out of the header\n", cell.sprite.name.c_str());
+			continue;
+		}
+
+		cells.push_back(&cell);
+		names.push_back(cell.sprite.name);
+	}
+
+	std::vector<int32_t> displace;
+	std::vector<uint32_t> slots;
+	if (names.empty() || !perfect_hash::build(names, displace, slots))
+	{
+		printf("[TEX] Can't generate '%s'\n", header_fname.c_str());
+		return;
+	}
+
+	//Sprite IDs are the perfect hash slots, so lookups index the tables directly
+	std::vector<const cell *> by_id(cells.size());
+	for (size_t i = 0; i < cells.size(); ++i)
+		by_id[slots[i]] = cells[i];
+
+	std::vector<std::string> ids;
+	for (auto cell : by_id)
+	{
+		std::string id = identifier(cell->sprite.name);
+		std::string unique = id;
+		for (int n = 2; std::find(ids.begin(), ids.end(), unique) != ids.end(); ++n)
+			unique = id + "_" + std::to_string(n);
+		ids.push_back(unique);
+	}
+
+	static const emitter::format begin_format(
+		"//Generated by texpack from '%r' - do not edit\n"
+		"#pragma once\n"
+		"#include <cstdint>\n"
+		"\n"
+		"namespace atlas\n"
+		"{\n"
+		"\tnamespace %r\n"
+		"\t{\n"
+		"\t\t//Texture file (of the first page)\n"
+		"\t\tconstexpr const char * texture = \"%r\";\n"
+		"\t\t//Texture files of all pages\n"
+		"\t\tconstexpr const char * textures[%d] = { %r };\n"
+		"\t\t//Number of sprites\n"
+		"\t\tconstexpr uint16_t count = %d;\n"
+		"\n"
+		"\t\t//Sprite IDs\n"
+		"\t\tenum class sprite : uint16_t\n"
+		"\t\t{\n");
+	static const emitter::format id_format("\t\t\t%r = %d,\n");
+	static const emitter::format frames_format(
+		"\t\t\tinvalid = 0xFFFF,\n"
+		"\t\t};\n"
+		"\n"
+		"\t\t//A frame in the texture\n"
+		"\t\tstruct frame\n"
+		"\t\t{\n"
+		"\t\t\tuint16_t x, y, w, h;\n"
+		"\t\t\tint16_t offset_x, offset_y;\n"
+		"\t\t\tbool rotated;\n"
+		"\t\t\t//Channel when channel packed (0-3 = R, G, B, A)\n"
+		"\t\t\tuint8_t channel;\n"
+		"\t\t\t//Page (index in textures)\n"
+		"\t\t\tuint16_t page;\n"
+		"\t\t};\n"
+		"\n"
+		"\t\t//Frames, indexed by sprite ID\n"
+		"\t\tconstexpr frame frames[count] =\n"
+		"\t\t{\n");
+	static const emitter::format frame_format("\t\t\t{ %d, %d, %d, %d, %d, %d, %r, %d, %d },\n");
+	static const emitter::format names_format(
+		"\t\t};\n"
+		"\n"
+		"\t\t//Sprite names, indexed by sprite ID\n"
+		"\t\tconstexpr const char * names[count] =\n"
+		"\t\t{\n");
+	static const emitter::format name_format("\t\t\t\"%r\",\n");
+	static const emitter::format hash_format(
+		"\t\t};\n"
+		"\n"
+		"\t\tnamespace detail\n"
+		"\t\t{\n"
+		"\t\t\t//Same hash as texpack's perfect_hash::hash\n"
+		"\t\t\tconstexpr uint32_t shift_xor(uint32_t h, int shift) { return h ^ (h >> shift); }\n"
+		"\t\t\tconstexpr uint32_t fnv(const char * s, uint32_t h) { return *s ? fnv(s + 1, (h ^ (unsigned char)*s) * 16777619u) : h; }\n"
+		"\t\t\tconstexpr uint32_t hash(const char * s, uint32_t seed) { return shift_xor(shift_xor(shift_xor(fnv(s, 2166136261u ^ (seed * 0x9E3779B9u)), 16) * 0x85EBCA6Bu, 13) * 0xC2B2AE35u, 16); }\n"
+		"\t\t\tconstexpr bool equal(const char * a, const char * b) { return *a == *b && (*a == '\\0' || equal(a + 1, b + 1)); }\n"
+		"\n"
+		"\t\t\t//Bucket displacements (negative values are direct slots)\n"
+		"\t\t\tconstexpr int32_t displace[%d] =\n"
+		"\t\t\t{\n");
+	static const emitter::format end_format(
+		"\t\t\t};\n"
+		"\n"
+		"\t\t\tconstexpr uint32_t slot(const char * name, int32_t d) { return d < 0 ? (uint32_t)(-d - 1) : hash(name, (uint32_t)d) %% count; }\n"
+		"\t\t\tconstexpr uint32_t slot(const char * name) { return slot(name, displace[hash(name, 0) %% %d]); }\n"
+		"\t\t\tconstexpr sprite check(const char * name, uint32_t s) { return equal(names[s], name) ? (sprite)s : sprite::invalid; }\n"
+		"\t\t}\n"
+		"\n"
+		"\t\t//Sprite ID by name (sprite::invalid if missing), works at compile time\n"
+		"\t\tconstexpr sprite find(const char * name) { return detail::check(name, detail::slot(name)); }\n"
+		"\t\t//Frame of a sprite\n"
+		"\t\tconstexpr const frame & get(sprite id) { return frames[(uint16_t)id]; }\n"
+		"\t}\n"
+		"}\n");
+
+	core::fs::path sheet = header_fname;
+	emitter out;
+	out.emit(begin_format, { texture_fname, identifier(sheet.stem().string()), literal(texture_fname), (int)texture_fnames.size(), textures, (int)by_id.size() });
+
+	for (size_t i = 0; i < by_id.size(); ++i)
+		out.emit(id_format, { ids[i], (int)i });
+
+	out.emit(frames_format, { });
+	for (auto cell : by_id)
+	{
+		//Same values as the plist (-2 coz extensions)
+		out.emit(frame_format, {
+			cell->x + 1, cell->y + 1, (int)(cell->w - cell->pad_w) - 2, (int)(cell->h - cell->pad_h) - 2,
+			cell->sprite.offset.x, cell->sprite.offset.y,
+			cell->flipped ? "true" : "false", cell->channel, cell->page });
+	}
+
+	out.emit(names_format, { });
+	for (auto cell : by_id)
+		out.emit(name_format, { literal(cell->sprite.name) });
+
+	out.emit(hash_format, { (int)displace.size() });
+	for (auto d : displace)
+	{
+		out.write("\t\t\t\t");
+		out.write_int(d);
+		out.write(",\n");
+	}
+
+	out.emit(end_format, { (int)displace.size() });
+
+	core::fwriter writer(header_fname, true);
+	out.flush(writer);
+	writer.close();
+}
+
+void texture_packer::save_binary(const std::string & index_fname, const std::vector<std::string> & texture_fnames, const std::vector<std::string> & alpha_fnames)
+{
+	using namespace atlas_index;
+
+	//String pool - names are zero terminated
+	std::string strings;
+	auto add_string = [&strings](const std::string & str)
+	{
+		uint32_t offset = (uint32_t)strings.size();
+		strings.append(str);
+		strings.push_back('\0');
+		return offset;
+	};
+
+	std::vector<frame> frames;
+	std::vector<atlas_index::slice> slices;
+	bool sliced = false;
+	frames.reserve(_info.size());
+	slices.reserve(_info.size());
+	for (auto & cell : _info)
+	{
+		const sprite & spr = cell.sprite;
+		//Same values as the plist (-2 coz extensions)
+		frame frm;
+		memset(&frm, 0, sizeof(frm));
+		frm.name = add_string(spr.name);
+		frm.hash = hash(spr.name.c_str());
+		frm.x = (uint16_t)(cell.x + 1);
+		frm.y = (uint16_t)(cell.y + 1);
+		frm.w = (uint16_t)(cell.w - 2 - cell.pad_w);
+		frm.h = (uint16_t)(cell.h - 2 - cell.pad_h);
+		frm.offset_x = (int16_t)spr.offset.x;
+		frm.offset_y = (int16_t)spr.offset.y;
+		frm.source_w = frm.w;
+		frm.source_h = frm.h;
+		frm.page = (uint16_t)cell.page;
+		frm.flags = cell.flipped ? rotated : 0;
+		frm.channel = (uint8_t)cell.channel;
+
+		atlas_index::slice slc;
+		memset(&slc, 0, sizeof(slc));
+		if (spr.nine_slice)
+		{
+			frm.flags |= nine_slice;
+			slc.left = (uint16_t)spr.slice.left;
+			slc.top = (uint16_t)spr.slice.top;
+			slc.right = (uint16_t)spr.slice.right;
+			slc.bottom = (uint16_t)spr.slice.bottom;
+			sliced = true;
+		}
+
+		frames.push_back(frm);
+		slices.push_back(slc);
+	}
+
+	//Readers binary search by hash, slices stay in the order of their frames
+	std::vector<size_t> order(frames.size());
+	for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(),
+		[&frames](size_t a, size_t b) { return frames[a].hash < frames[b].hash; });
+
+	std::vector<frame> sorted_frames;
+	std::vector<atlas_index::slice> sorted_slices;
+	for (auto i : order)
+	{
+		sorted_frames.push_back(frames[i]);
+		sorted_slices.push_back(slices[i]);
+	}
+	frames.swap(sorted_frames);
+	slices.swap(sorted_slices);
+	if (!sliced) slices.clear();
+
+	std::vector<atlas_index::page> pages;
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		const texture_packer::page & source = _pages[i];
+		img::alpha_layout alpha = etc1_alpha(source);
+
+		atlas_index::page pg;
+		memset(&pg, 0, sizeof(pg));
+		pg.name = add_string(texture_fnames[i]);
+		//Readers find the mask's name right after the texture's
+		if (!alpha_fnames[i].empty())
+		{
+			add_string(alpha_fnames[i]);
+			pg.flags |= alpha_mask;
+		}
+		pg.width = (uint16_t)source.image->w();
+		pg.height = (uint16_t)img::layout_height(source.image->h(), source.format, alpha);
+		pg.pixel_format = add_string(img::format_name(source.format));
+		if (source.format == img::etc1)
+		{
+			if (alpha == img::alpha_separate) pg.flags |= alpha_separate;
+			else if (alpha == img::alpha_bottom) pg.flags |= alpha_bottom;
+		}
+		if (_options.premultiply_alpha)
+			pg.flags |= premultiplied;
+		if (_options.channel_pack)
+			pg.flags |= channel_packed;
+		pages.push_back(pg);
+	}
+
+	while (strings.size() % 4 != 0)
+		strings.push_back('\0');
+
+	header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, magic, sizeof(hdr.magic));
+	hdr.version = version;
+	hdr.flags = sliced ? has_slices : 0;
+	hdr.frame_count = (uint32_t)frames.size();
+	hdr.page_count = (uint32_t)pages.size();
+	hdr.frames_offset = sizeof(header);
+	hdr.pages_offset = hdr.frames_offset + hdr.frame_count * sizeof(frame);
+	hdr.strings_offset = hdr.pages_offset + hdr.page_count * sizeof(atlas_index::page) + (uint32_t)(slices.size() * sizeof(atlas_index::slice));
+	hdr.strings_size = (uint32_t)strings.size();
+
+	core::fwriter writer(index_fname, true);
+	writer.write(hdr);
+	writer.write(frames.data(), frames.size());
+	writer.write(pages.data(), pages.size());
+	if (!slices.empty())
+		writer.write(slices.data(), slices.size());
+	writer.write(strings);
+	writer.close();
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void texture_packer::blit(const sprite & sprite, img::img * image, const binpack::rect_xywhf & blitrect)
+void texture_packer::blit(const sprite & sprite, img::img * image, const binpack::rect_xywhf & blitrect, unsigned channel, unsigned pad_w, unsigned pad_h)
 {
 	cell info;
 	info.sprite = sprite;
@@ -257,6 +1118,9 @@ void texture_packer::blit(const sprite & sprite, img::img * image, const binpack
 	info.y = blitrect.y;
 	info.w = blitrect.w;
 	info.h = blitrect.h;
+	info.pad_w = pad_w;
+	info.pad_h = pad_h;
+	info.channel = channel;
 	info.flipped = false;
 
 	if (!blitrect.issquare())
@@ -266,25 +1130,24 @@ void texture_packer::blit(const sprite & sprite, img::img * image, const binpack
 		{
 			assert(blitrect.h == image->w());
 			info.flipped = true;
+			std::swap(info.pad_w, info.pad_h);
 			//Fix flipped image bounds
 			info.h--;
 			info.y += info.h;
 		}
 	}
 
+	//Sprites go to the page being packed
+	info.page = (unsigned)_pages.size() - 1;
+	img::img * target = _pages.back().image;
+
 	_info.push_back(info);
 	//printf("[Atlas] Blitting '%s'\n", fname.c_str());
 
-	if (info.flipped)
-	{
-		for (unsigned yy = 0; yy < image->h(); yy++)
-			for (unsigned xx = 0; xx < image->w(); xx++)
-				_img->set(info.x + yy, info.y - xx, image->get(xx, yy));
-	}
+	if (_options.channel_pack)
+		target->blit_channel(*image, info.x, info.y, channel, info.flipped);
+	else if (info.flipped)
+		target->blit_rotated(*image, info.x, info.y);
 	else
-	{
-		for (unsigned yy = 0; yy < image->h(); yy++)
-			for (unsigned xx = 0; xx < image->w(); xx++)
-				_img->set(info.x + xx, info.y + yy, image->get(xx, yy));
-	}
+		target->blit(*image, info.x, info.y);
 }
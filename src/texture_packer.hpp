@@ -25,7 +25,13 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEAL
 #include "util/rect.hpp"
 #include "util/size.hpp"
 #include "img/img.hpp"
+#include "img/png.hpp"
+#include "img/polygon.hpp"
+#include "img/slice.hpp"
+#include "options.hpp"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -37,6 +43,25 @@ struct sprite
 	std::string path;
 	util::point offset;
 	util::vec2 scale;
+	//Stretched as a nine-slice, its identical middle columns and rows are packed as one
+	bool nine_slice = false;
+	//Nine-slice borders in source pixels (found from the pixels if all 0), in texture pixels once prepared
+	img::insets slice = { 0, 0, 0, 0 };
+};
+
+//Decoded source images, shared by the packers of a sheet so every file is decoded once
+class sprite_images
+{
+	std::map<std::string, img::img *> _images;
+
+public:
+	sprite_images() = default;
+	~sprite_images();
+	sprite_images(const sprite_images &) = delete;
+	sprite_images & operator = (const sprite_images &) = delete;
+
+	//Decoded image of a file, decoded on first use (nullptr if the format is unsupported)
+	const img::img * get(const std::string & fname);
 };
 
 class texture_packer
@@ -50,31 +75,83 @@ public:
 		int y;
 		unsigned w;
 		unsigned h;
+		//Extra extrusion on the right and bottom (block alignment)
+		unsigned pad_w;
+		unsigned pad_h;
+		//Channel the sprite is in when channel packed (0-3 = R, G, B, A)
+		unsigned channel;
+		//Page (texture) the sprite is on
+		unsigned page;
+		//Polygon around the sprite's visible pixels, relative to it (--polygons, empty otherwise)
+		img::mesh mesh;
+	};
+
+	//A texture of the sheet
+	struct page
+	{
+		img::img * image;
+		//Texture pixel format
+		img::pixel_format format;
+		//Holds only opaque sprites (ETC1 keeps no alpha)
+		bool opaque;
+		//Written as a JPEG
+		bool jpeg;
+		//Alpha written to a mask file next to the JPEG (--jpeg-alpha)
+		bool alpha_mask;
+		//Pixel layout of PNGs (palettized or gray)
+		img::png_layout layout;
+		//Added to the texture and plist names ("" for the first page)
+		std::string suffix;
 	};
 	
 private:
-	img::img * _img;
+	std::vector<page> _pages;
 
 	bool _alpha;
 	bool _generated;
 	std::vector<cell> _info;
 	std::vector<sprite> _sprites;
 	std::string _base_dir;
+	options _options;
+	std::shared_ptr<sprite_images> _images;
 
 public:
-	texture_packer(bool alpha, const std::string & base_dir);
+	texture_packer(bool alpha, const std::string & base_dir, const options & opts = options(), std::shared_ptr<sprite_images> images = nullptr);
 	~texture_packer();
 
 	bool add(const sprite & sprite);
 
 	inline bool generated() const { return _generated; };
-	inline const img::img * image() const { return _img; }
+	inline const img::img * image() const { return _pages.empty() ? nullptr : _pages[0].image; }
+	inline const std::vector<page> & pages() const { return _pages; }
 	inline std::vector<cell> info() const { return _info; }
 
 	int pack();
 	void save(std::string & fname, std::string & index_fname);
 
 private:
-	void pack_internal(const std::vector<util::rect> & rects, const std::vector<int> & order);
-	void blit(const sprite & sprite, img::img * image, const binpack::rect_xywhf & blitrect);
+	//Pack images into a page of the sheet's format (or its opaque counterpart), false if they don't fit
+	bool pack_page(const std::vector<img::png *> & images, const std::vector<int> & order, bool opaque, const std::string & suffix);
+	//Pack images into a new page, false if they don't fit
+	bool pack_internal(const std::vector<img::png *> & images, const std::vector<int> & order, page pg);
+	//Scale of a sprite in the texture (its own times the sheet's)
+	util::vec2 scale(const sprite & spr) const;
+	//Scaled sprite with extensions (nullptr if its format is unsupported), nine-slices cut down and their borders updated
+	img::png * prepare(sprite & spr);
+	//Pick a page's format from its sprites' pixels, returns what was found
+	std::string choose_format(const std::vector<img::png *> & images, page & pg);
+	//Opaque counterpart of the requested format, for the page of opaque sprites
+	img::pixel_format opaque_format() const;
+	//Where ETC1 keeps the alpha of a page
+	img::alpha_layout etc1_alpha(const page & pg) const;
+	//Create an empty texture of a page's format
+	img::img * create_image(const page & pg, unsigned w, unsigned h) const;
+	//Mip levels of a page, every cell (and channel) filtered on its own
+	std::vector<img::png *> mipmaps(unsigned index) const;
+	//Write a page's texture (or a mip level of it) as "<name><ext>", and its alpha mask at the same time
+	void save_texture(const page & pg, img::img & image, const std::string & name, const std::string & ext) const;
+	void save_plist(const std::string & index_fname, const std::string & texture_fname, const std::string & alpha_fname, unsigned page_index);
+	void save_binary(const std::string & index_fname, const std::vector<std::string> & texture_fnames, const std::vector<std::string> & alpha_fnames);
+	void save_header(const std::string & header_fname, const std::vector<std::string> & texture_fnames);
+	void blit(const sprite & sprite, img::img * image, const binpack::rect_xywhf & blitrect, unsigned channel, unsigned pad_w = 0, unsigned pad_h = 0);
 };
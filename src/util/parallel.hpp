@@ -0,0 +1,53 @@
+/*
+
+Copyright (c) 2016 Botyto
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+	//Split [0, count) into contiguous bands and call fn(begin, end) for each, one band per hardware thread
+	//Bands are never smaller than min_band, so small jobs stay on the calling thread
+	template<class Fn>
+	void parallel_bands(size_t count, size_t min_band, Fn fn)
+	{
+		size_t threads = std::max(1u, std::thread::hardware_concurrency());
+		size_t bands = std::min(threads, (count + min_band - 1) / std::max<size_t>(min_band, 1));
+		if (bands <= 1)
+		{
+			fn((size_t)0, count);
+			return;
+		}
+
+		size_t band = (count + bands - 1) / bands;
+		std::vector<std::thread> workers;
+		for (size_t begin = band; begin < count; begin += band)
+			workers.emplace_back(fn, begin, std::min(count, begin + band));
+
+		//The calling thread takes the first band
+		fn((size_t)0, band);
+
+		for (auto & worker : workers)
+			worker.join();
+	}
+}
@@ -31,6 +31,9 @@ namespace texedit
         public string Name;
         public Point Offset;
         public PointF Scale;
+        //"NineSlice" member (true or the border widths), null if the sprite isn't one
+        //Not edited here, only kept as it is (internal, so the mapper leaves it alone)
+        internal LitJson.JsonData NineSlice;
     }
 
     class Spritesheet
@@ -38,6 +41,10 @@ namespace texedit
         public List<Sprite> Sprites { get; private set; }
         public string BaseDir       { get; private set; }
         public string ProjectName   { get; private set; }
+        //Packing options ("Options" in the settings file), kept as they are
+        public LitJson.JsonData Options { get; private set; }
+        //Output profiles ("Profiles" in the settings file), kept as they are
+        public LitJson.JsonData Profiles { get; private set; }
 
         public Spritesheet()
         {
@@ -67,8 +74,36 @@ namespace texedit
             string json = "";
             using (StreamReader sr = new StreamReader(settings_file))
                 json = sr.ReadToEnd();
+            //Either a plain list of sprites or { "Options": {...}, "Profiles": {...}, "Sprites": [...] }
+            var data = LitJson.JsonMapper.ToObject(json);
+            Options = null;
+            Profiles = null;
+            if (data.IsObject)
+            {
+                if (data.Keys.Contains("Options"))
+                    Options = data["Options"];
+                if (data.Keys.Contains("Profiles"))
+                    Profiles = data["Profiles"];
+                json = data["Sprites"].ToJson();
+            }
+
             LitJson.JsonReader reader = new LitJson.JsonReader(json);
             Sprites = LitJson.JsonMapper.ToObject<List<Sprite>>(reader);
+
+            var items = LitJson.JsonMapper.ToObject(json);
+            for (int i = 0; i < Sprites.Count && i < items.Count; ++i)
+                if (items[i].IsObject && items[i].Keys.Contains("NineSlice"))
+                    Sprites[i].NineSlice = items[i]["NineSlice"];
+        }
+
+        //Sprites as JSON, with the members that aren't edited put back
+        LitJson.JsonData SpriteList()
+        {
+            var list = LitJson.JsonMapper.ToObject(LitJson.JsonMapper.ToJson(Sprites));
+            for (int i = 0; i < Sprites.Count; ++i)
+                if (Sprites[i].NineSlice != null)
+                    list[i]["NineSlice"] = Sprites[i].NineSlice;
+            return list;
         }
 
         public void Save()
@@ -79,7 +114,26 @@ namespace texedit
                 LitJson.JsonWriter jwriter = new LitJson.JsonWriter(writer);
                 jwriter.PrettyPrint = true;
                 jwriter.IndentValue = 4;
-                LitJson.JsonMapper.ToJson(Sprites, jwriter);
+                if (Options == null && Profiles == null)
+                {
+                    SpriteList().ToJson(jwriter);
+                    return;
+                }
+
+                jwriter.WriteObjectStart();
+                if (Options != null)
+                {
+                    jwriter.WritePropertyName("Options");
+                    Options.ToJson(jwriter);
+                }
+                if (Profiles != null)
+                {
+                    jwriter.WritePropertyName("Profiles");
+                    Profiles.ToJson(jwriter);
+                }
+                jwriter.WritePropertyName("Sprites");
+                SpriteList().ToJson(jwriter);
+                jwriter.WriteObjectEnd();
             }
         }
     }